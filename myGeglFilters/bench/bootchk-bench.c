@@ -0,0 +1,896 @@
+/*
+Microbenchmark of the kernels library, without GEGL.
+
+Times each kernel over a synthetic image in plain arrays,
+so there is no graph, no tile traversal, and no babl conversion in the timing.
+Compare to timing the filters in GEGL (see tools/bootchk-batch.c)
+to see what the traversal around the kernels costs.
+
+Usage:
+
+  bootchk-bench [-w WIDTH] [-h HEIGHT] [-n ITERATIONS] [-p WORKLOAD] [-c] [-H] [KERNEL...]
+  bootchk-bench [-w WIDTH] [-h HEIGHT] -p WORKLOAD -o FILE.pgm
+
+Kernels: nms, nms-squared, nms-half, brushfire, threshold, threshold-squared, threshold-half,
+sobel, gradient, gradient-squared, remove-weak-fused, remove-weak-node,
+half-to-float, float-to-half, area-template, area-strips, pads-separate, pads-shared.
+Default all.
+The -squared kernels are of squared magnitudes, as in canny.
+The -half kernels read and write half floats, as canny with half-precision,
+computing in float: compare to the -squared kernels on images larger than the cache.
+The area- kernels are the template of area ops, examples/areaOp,
+as it was (whole rects, pointers clamped per pixel) and streamed in strips.
+The pads- kernels are the job of the gradient in false color and the edges,
+as two graphs computing the gradient each, and as one graph of canny's pads.
+Reports the best and the mean of the iterations, per pixel.
+
+Workloads, the gradient field of the NMS, threshold, and hysteresis kernels,
+see workloads.c: random (default), spiral, weak-noise, texture, sectors.
+The spiral and weak-noise are the worst cases of the brushfire,
+superlinear, so bench them at small sizes.
+With -o, writes the magnitudes of the workload to a PGM file, and benches nothing.
+
+With -c, also reports hardware counters per pixel, see counters.c:
+cycles, instructions per cycle, branch misses, last level cache misses,
+and the bytes read by those misses (a cache line each), i.e. from memory.
+Counters not available are reported as "-", e.g. in a VM.
+
+With -H, also runs NMS, threshold, and brushfire over the workload
+with intermediates in float and in half floats, as canny with half-precision,
+and reports the pixels where the edges differ.
+
+The kernels run as compiled for this CPU, the best variant it supports, see kernels/dispatch.c.
+BOOTCHK_CPU=sse2 (or avx2, avx512) in the environment benches another, to compare them.
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bootchk-kernels.h"
+#include "counters.h"
+#include "workloads.h"
+
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define CACHE_LINE_BYTES 64
+
+typedef struct
+{
+  int    width;
+  int    height;
+  float *gradient;  // magnitude, direction; width x height plus a one pixel border
+  float *rgba;      // width x height
+  float *rgb;       // width x height plus a one pixel border
+  float *planes;    // the same, deinterleaved, three planes
+  float *out;       // width x height, four floats per pixel, for any kernel
+  float *out2;      // width x height, two floats per pixel, the buffer of a second node
+  float *hsv;       // width x height, three floats per pixel, of false color
+  float *rows;      // four rows of the bordered gradient, floats converted from halves
+  uint16_t *gradient_half;  // the gradient, bordered, as half floats
+  uint16_t *out_half;       // width x height, two halves per pixel
+  uint8_t *states;  // width x height, pristine
+  uint8_t *work;    // width x height, mutated by the brushfire
+} Image;
+
+
+static double
+now_seconds (void)
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Deterministic, so runs are comparable. */
+static float
+random_float (unsigned int *seed)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  return (*seed >> 8) / (float) (1 << 24);
+}
+
+/*
+Data shaped like what the filters see in canny:
+a gradient field of mostly weak magnitudes, directions all around,
+and hysteresis states of mostly black with a sprinkling of weak and strong.
+*/
+static void
+image_init (Image *image, int width, int height)
+{
+  unsigned int seed = 1;
+  size_t       bordered = (size_t) (width + 2) * (height + 2);
+  size_t       i;
+
+  image->width    = width;
+  image->height   = height;
+  image->gradient = malloc (bordered * 2 * sizeof (float));
+  image->rgb      = malloc (bordered * 3 * sizeof (float));
+  image->planes   = malloc (bordered * 3 * sizeof (float));
+  image->rgba     = malloc ((size_t) width * height * 4 * sizeof (float));
+  image->out      = malloc ((size_t) width * height * 4 * sizeof (float));
+  image->out2     = malloc ((size_t) width * height * 2 * sizeof (float));
+  image->hsv      = malloc ((size_t) width * height * 3 * sizeof (float));
+  image->rows     = malloc ((size_t) (width + 2) * 2 * 4 * sizeof (float));
+  image->gradient_half = malloc (bordered * 2 * sizeof (uint16_t));
+  image->out_half      = malloc ((size_t) width * height * 2 * sizeof (uint16_t));
+  image->states   = malloc ((size_t) width * height);
+  image->work     = malloc ((size_t) width * height);
+
+  for (i = 0; i < bordered; i++)
+    {
+      image->gradient[i * 2]     = random_float (&seed);
+      image->gradient[i * 2 + 1] = (random_float (&seed) * 2 - 1) * M_PI;
+    }
+
+  bootchk_float_to_half (image->gradient, image->gradient_half, bordered * 2);
+
+  for (i = 0; i < bordered * 3; i++)
+    image->rgb[i] = random_float (&seed);
+
+  for (i = 0; i < (size_t) width * height * 4; i++)
+    image->rgba[i] = random_float (&seed);
+
+  for (i = 0; i < (size_t) width * height; i++)
+    {
+      float r = random_float (&seed);
+
+      image->states[i] = r < 0.85 ? 0 : bootchk_hyst_state_of_magnitude (random_float (&seed));
+    }
+}
+
+static void
+image_free (Image *image)
+{
+  free (image->gradient);
+  free (image->rgb);
+  free (image->planes);
+  free (image->rgba);
+  free (image->out);
+  free (image->out2);
+  free (image->hsv);
+  free (image->rows);
+  free (image->gradient_half);
+  free (image->out_half);
+  free (image->states);
+  free (image->work);
+}
+
+/*
+Replace the random gradient field by a workload,
+and the states by those of the workload: double thresholded, as in canny.
+The border of the field stays black.
+*/
+static void
+image_set_workload (Image *image, Workload workload)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  int       row;
+
+  memset (image->gradient, 0, (size_t) stride * (image->height + 2) * sizeof (float));
+  workload_fill (workload, image->gradient + stride + 2, image->width, image->height, stride, 1);
+  bootchk_float_to_half (image->gradient, image->gradient_half,
+                         (size_t) stride * (image->height + 2));
+
+  for (row = 0; row < image->height; row++)
+    {
+      float *thresholded = image->out + (size_t) row * image->width * 2;
+
+      bootchk_double_threshold (image->gradient + (row + 1) * stride + 2, thresholded,
+                                image->width, 0.3f, 0.8f);
+      bootchk_hyst_states_of_row (thresholded, 2,
+                                  image->states + (size_t) row * image->width, image->width);
+    }
+}
+
+
+static void
+nms (Image *image, int squared)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  int       row;
+
+  for (row = 0; row < image->height; row++)
+    {
+      const float *mid = image->gradient + (row + 1) * stride + 2;
+
+      bootchk_nms_span (mid - stride, mid, mid + stride,
+                        image->out + (size_t) row * image->width * 2,
+                        image->width, squared);
+    }
+}
+
+static void
+run_nms (Image *image)
+{
+  nms (image, 0);
+}
+
+/* The magnitudes taken as squared, the cost of the exact comparison. */
+static void
+run_nms_squared (Image *image)
+{
+  nms (image, 1);
+}
+
+/*
+As the op with half floats: the field converted to floats in cache,
+here a row at a time into a ring of three rows, suppressed,
+and the result converted back. Half the bytes of nms-squared to and from memory.
+*/
+static void
+run_nms_half (Image *image)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  float    *out    = image->rows + 3 * stride;
+  int       row;
+
+  bootchk_half_to_float (image->gradient_half, image->rows, 2 * stride);
+
+  for (row = 0; row < image->height; row++)
+    {
+      float *top  = image->rows + (row % 3) * stride;
+      float *mid  = image->rows + ((row + 1) % 3) * stride;
+      float *down = image->rows + ((row + 2) % 3) * stride;
+
+      bootchk_half_to_float (image->gradient_half + (row + 2) * stride, down, stride);
+      bootchk_nms_span (top + 2, mid + 2, down + 2, out, image->width, 1);
+      bootchk_float_to_half (out, image->out_half + (size_t) row * image->width * 2,
+                             (size_t) image->width * 2);
+    }
+}
+
+/* Brushfire until the fire is out, as hysteresis does. */
+static void
+run_brushfire (Image *image)
+{
+  memcpy (image->work, image->states, (size_t) image->width * image->height);
+
+  while (bootchk_hyst_brushfire (image->work, image->width, image->height, image->width) > 0)
+    ;
+}
+
+static void
+run_threshold (Image *image)
+{
+  bootchk_double_threshold (image->gradient, image->out,
+                            (long) image->width * image->height, 0.3f, 0.8f);
+}
+
+/* Including the exact squares of the thresholds, as the op per chunk. */
+static void
+run_threshold_squared (Image *image)
+{
+  float low, high;
+
+  bootchk_squared_threshold (0.3f, 0.8f, &low, &high);
+  bootchk_double_threshold_squared (image->gradient, image->out,
+                                    (long) image->width * image->height, low, high);
+}
+
+/* As the op with half floats: a block at a time, through floats on the stack. */
+static void
+run_threshold_half (Image *image)
+{
+  long  n = (long) image->width * image->height;
+  float low, high;
+  long  i;
+
+  bootchk_squared_threshold (0.3f, 0.8f, &low, &high);
+
+  for (i = 0; i < n; i += 1024)
+    {
+      float block[1024 * 2];
+      long  m = n - i < 1024 ? n - i : 1024;
+
+      bootchk_half_to_float (image->gradient_half + i * 2, block, m * 2);
+      bootchk_double_threshold_squared (block, block, m, low, high);
+      bootchk_float_to_half (block, image->out_half + i * 2, m * 2);
+    }
+}
+
+static void
+run_half_to_float (Image *image)
+{
+  bootchk_half_to_float (image->gradient_half, image->out,
+                         (size_t) image->width * image->height * 2);
+}
+
+static void
+run_float_to_half (Image *image)
+{
+  bootchk_float_to_half (image->gradient, image->out_half,
+                         (size_t) image->width * image->height * 2);
+}
+
+static void
+run_sobel (Image *image)
+{
+  bootchk_sobel_rgba (image->rgba, image->width, image->height, image->width * 4,
+                      image->out,  image->width, image->height, image->width * 4,
+                      1, 1, 1, 1);
+}
+
+/* As the op: deinterleave, then rows of planes. */
+static void
+gradient (Image *image, int squared)
+{
+  size_t    bordered = (size_t) (image->width + 2) * (image->height + 2);
+  ptrdiff_t stride   = image->width + 2;
+  int       row;
+
+  bootchk_deinterleave_rgb (image->rgb, image->planes,
+                            image->planes + bordered, image->planes + 2 * bordered,
+                            bordered);
+
+  for (row = 0; row < image->height; row++)
+    {
+      size_t       offset  = (row + 1) * stride + 1;
+      const float *mid[3]  = { image->planes + offset,
+                               image->planes + bordered + offset,
+                               image->planes + 2 * bordered + offset };
+      const float *top[3]  = { mid[0] - stride, mid[1] - stride, mid[2] - stride };
+      const float *down[3] = { mid[0] + stride, mid[1] + stride, mid[2] + stride };
+
+      bootchk_gradient_row_planar (top, mid, down,
+                                   image->out + (size_t) row * image->width * 2,
+                                   image->width, BOOTCHK_GRADIENT_BOTH, squared);
+    }
+}
+
+static void
+run_gradient (Image *image)
+{
+  gradient (image, 0);
+}
+
+static void
+run_gradient_squared (Image *image)
+{
+  gradient (image, 1);
+}
+
+
+/*
+The end of canny: hysteresis writes back, then weak values are removed.
+Fused, as hysteresis does with remove-weak:
+one pass, writing the binary result.
+*/
+static void
+run_remove_weak_fused (Image *image)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  int       row;
+
+  for (row = 0; row < image->height; row++)
+    bootchk_hyst_write_row (image->gradient + (row + 1) * stride + 2,
+                            image->states + (size_t) row * image->width,
+                            image->out + (size_t) row * image->width * 2,
+                            image->width, 1, NULL);
+}
+
+/*
+Not fused, as canny did before:
+hysteresis writes back weak values, then a second node thresholds them,
+into a second buffer as large as the image.
+*/
+static void
+run_remove_weak_node (Image *image)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  int       row;
+
+  for (row = 0; row < image->height; row++)
+    bootchk_hyst_write_row (image->gradient + (row + 1) * stride + 2,
+                            image->states + (size_t) row * image->width,
+                            image->out + (size_t) row * image->width * 2,
+                            image->width, 0, NULL);
+
+  bootchk_double_threshold (image->out, image->out2,
+                            (long) image->width * image->height, 0.8f, 0.8f);
+}
+
+
+/*
+The template of area ops, examples/areaOp, before and after streaming by strips.
+Both suppress by the template's per-pixel test, its direction in degrees:
+they differ only in the traversal, as the op's did.
+*/
+static int
+is_template_maximum (const float *top_left,    const float *top,    const float *top_right,
+                     const float *left,        const float *center, const float *right,
+                     const float *bottom_left, const float *bottom, const float *bottom_right)
+{
+  float angle = center[1] < 0.0f ? center[1] + 360.0f : center[1];
+
+  switch ((int) ((angle + 22.5f) / 45.0f) % 4)
+    {
+    case 0:  return center[0] > top[0]         && center[0] > bottom[0];
+    case 1:  return center[0] > top_left[0]    && center[0] > bottom_right[0];
+    case 2:  return center[0] > left[0]        && center[0] > right[0];
+    default: return center[0] > bottom_left[0] && center[0] > top_right[0];
+    }
+}
+
+/*
+As the template was: copy the whole source rect out (zeroed first, as g_new0),
+clamp the neighbor pointers per pixel, into a whole destination rect, copied back.
+*/
+static void
+run_area_template (Image *image)
+{
+  int       width    = image->width;
+  int       height   = image->height;
+  ptrdiff_t stride   = (ptrdiff_t) (width + 2) * 2;
+  size_t    bordered = (size_t) stride * (height + 2);
+  float    *src      = calloc (bordered, sizeof (float));
+  float    *dst      = calloc ((size_t) width * height * 2, sizeof (float));
+  float    *after    = src + bordered;
+  int       x, y;
+
+  memcpy (src, image->gradient, bordered * sizeof (float));
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        float *row_start    = src + (y + 1) * stride;
+        float *row_next     = row_start + stride;
+        float *center       = row_start + (x + 1) * 2;
+        float *left         = center - 2;
+        float *right        = center + 2;
+        float *top          = center - stride;
+        float *top_left     = top - 2;
+        float *top_right    = top + 2;
+        float *bottom       = center + stride;
+        float *bottom_left  = bottom - 2;
+        float *bottom_right = bottom + 2;
+
+        // The clamps of the template, tested per pixel, though the rect has a border.
+        if (top < src)
+          {
+            top_left += stride; top += stride; top_right += stride;
+          }
+        else if (bottom >= after)
+          {
+            bottom_left -= stride; bottom -= stride; bottom_right -= stride;
+          }
+
+        if (left < row_start)
+          {
+            top_left += 2; left += 2; bottom_left += 2;
+          }
+        else if (right >= row_next)
+          {
+            top_right -= 2; right -= 2; bottom_right -= 2;
+          }
+
+        dst[((size_t) y * width + x) * 2]     = is_template_maximum (top_left, top, top_right,
+                                                                     left, center, right,
+                                                                     bottom_left, bottom, bottom_right)
+                                                ? center[0] : 0.0f;
+        dst[((size_t) y * width + x) * 2 + 1] = center[1];
+      }
+
+  memcpy (image->out, dst, (size_t) width * height * 2 * sizeof (float));
+  free (src);
+  free (dst);
+}
+
+/* The callbacks of the strips, as the op's get and set: copies of rows of the image. */
+static void
+area_fetch (void *data, int y, int n_rows, float *rows)
+{
+  Image *image = data;
+
+  memcpy (rows, image->gradient + (size_t) (y + 1) * (image->width + 2) * 2,
+          (size_t) n_rows * (image->width + 2) * 2 * sizeof (float));
+}
+
+static void
+area_filter (void *data, const float *const *rows, float *out, int width)
+{
+  int x;
+
+  (void) data;
+
+  for (x = 0; x < width; x++)
+    {
+      const float *top    = rows[0] + x * 2;
+      const float *center = rows[1] + x * 2;
+      const float *bottom = rows[2] + x * 2;
+
+      out[x * 2]     = is_template_maximum (top - 2,    top,    top + 2,
+                                            center - 2, center, center + 2,
+                                            bottom - 2, bottom, bottom + 2)
+                       ? center[0] : 0.0f;
+      out[x * 2 + 1] = center[1];
+    }
+}
+
+static int
+area_store (void *data, int y, int n_rows, const float *rows)
+{
+  Image *image = data;
+
+  memcpy (image->out + (size_t) y * image->width * 2, rows,
+          (size_t) n_rows * image->width * 2 * sizeof (float));
+
+  return 0;
+}
+
+/* As the template is: streamed in strips through a ring of rows, see BootchkAreaStrips. */
+static void
+run_area_strips (Image *image)
+{
+  BootchkAreaStrips strips = { image->width, image->height, 1, 2, 2,
+                               32 * 1024 / (image->width + 2),
+                               area_fetch, area_filter, area_store, image, NULL };
+  float            *scratch;
+
+  if (strips.strip_rows < 1)
+    strips.strip_rows = 1;
+
+  scratch = malloc (bootchk_area_scratch_floats (&strips) * sizeof (float));
+  bootchk_area_run (&strips, scratch);
+  free (scratch);
+}
+
+
+/* Round trip n floats through half floats, as a buffer of halves between two nodes. */
+static void
+round_trip_half (float *values, uint16_t *halves, size_t n)
+{
+  bootchk_float_to_half (values, halves, n);
+  bootchk_half_to_float (halves, values, n);
+}
+
+/*
+The edges of canny from the squared magnitudes of field, bordered, into states:
+NMS, threshold, hysteresis, each stage stored, in half floats when half.
+Maxima, unless NULL, gets the magnitudes of the NMS.
+*/
+static void
+edges (const Image *image, const float *field, int half, float *maxima, uint8_t *states)
+{
+  ptrdiff_t stride = (ptrdiff_t) (image->width + 2) * 2;
+  size_t    n      = (size_t) image->width * image->height;
+  float    *nmsed  = malloc (n * 2 * sizeof (float));
+  uint16_t *halves = malloc (n * 2 * sizeof (uint16_t));
+  float     low, high;
+  int       row;
+
+  for (row = 0; row < image->height; row++)
+    {
+      const float *mid = field + (row + 1) * stride + 2;
+
+      bootchk_nms_span (mid - stride, mid, mid + stride,
+                        nmsed + (size_t) row * image->width * 2, image->width, 1);
+    }
+  if (half)
+    round_trip_half (nmsed, halves, n * 2);
+  if (maxima != NULL)
+    memcpy (maxima, nmsed, n * 2 * sizeof (float));
+
+  bootchk_squared_threshold (0.3f, 0.8f, &low, &high);
+  bootchk_double_threshold_squared (nmsed, nmsed, (long) n, low, high);
+  if (half)
+    round_trip_half (nmsed, halves, n * 2);
+
+  for (row = 0; row < image->height; row++)
+    bootchk_hyst_states_of_row (nmsed + (size_t) row * image->width * 2, 2,
+                                states + (size_t) row * image->width, image->width);
+
+  while (bootchk_hyst_brushfire (states, image->width, image->height, image->width) > 0)
+    ;
+
+  free (nmsed);
+  free (halves);
+}
+
+/* An edge after hysteresis: not black, and not left weak. */
+static int
+is_edge (uint8_t state)
+{
+  return state != 0 && ! (state & BOOTCHK_HYST_WEAK);
+}
+
+/*
+Compare the edges of canny with intermediates in float and in half floats.
+The field is the workload's, squared as canny's gradient, and rounded to half for both:
+only the storing of the intermediates differs.
+*/
+static void
+compare_half (const Image *image)
+{
+  ptrdiff_t stride   = (ptrdiff_t) (image->width + 2) * 2;
+  size_t    bordered = (size_t) stride * (image->height + 2);
+  size_t    n        = (size_t) image->width * image->height;
+  float    *field    = malloc (bordered * sizeof (float));
+  uint16_t *halves   = malloc (bordered * sizeof (uint16_t));
+  float    *maxima_f = malloc (n * 2 * sizeof (float));
+  float    *maxima_h = malloc (n * 2 * sizeof (float));
+  uint8_t  *states_f = malloc (n);
+  uint8_t  *states_h = malloc (n);
+  size_t    edges_f  = 0;
+  size_t    differ_maxima = 0;
+  size_t    differ_edges  = 0;
+  size_t    i;
+
+  for (i = 0; i < bordered; i += 2)
+    {
+      field[i]     = image->gradient[i] * image->gradient[i];
+      field[i + 1] = image->gradient[i + 1];
+    }
+  round_trip_half (field, halves, bordered);
+
+  edges (image, field, 0, maxima_f, states_f);
+  edges (image, field, 1, maxima_h, states_h);
+
+  for (i = 0; i < n; i++)
+    {
+      edges_f       += is_edge (states_f[i]);
+      differ_maxima += (maxima_f[i * 2] > 0.0f) != (maxima_h[i * 2] > 0.0f);
+      differ_edges  += is_edge (states_f[i]) != is_edge (states_h[i]);
+    }
+
+  printf ("half vs float: %zu of %zu NMS maxima differ, %zu of %zu edge pixels differ (%.4f%%)\n",
+          differ_maxima, n, differ_edges, edges_f,
+          edges_f > 0 ? 100.0 * differ_edges / edges_f : 0.0);
+
+  free (field);
+  free (halves);
+  free (maxima_f);
+  free (maxima_h);
+  free (states_f);
+  free (states_h);
+}
+
+
+/*
+The job of canny's pads: the gradient in false color, and the edges.
+The edges are of the workload's field, as the kernels above: the work of the job, not its data flow.
+*/
+static void
+false_color_and_edges (Image *image, int squared)
+{
+  // Emphasis doubled of squares, as bootchk:false-color-filter with squared.
+  bootchk_false_color (image->out, image->hsv, (size_t) image->width * image->height,
+                       squared ? 4.0f : 2.0f);
+  edges (image, image->gradient, 0, NULL, image->work);
+}
+
+/*
+As two graphs: bootchk:false-color-gradient-filter computes the gradient,
+and canny computes it again, squared.
+*/
+static void
+run_pads_separate (Image *image)
+{
+  gradient (image, 0);
+  gradient (image, 1);
+  false_color_and_edges (image, 0);
+}
+
+/* As one graph reading canny's pads: the squared gradient once, false colored as squared. */
+static void
+run_pads_shared (Image *image)
+{
+  gradient (image, 1);
+  false_color_and_edges (image, 1);
+}
+
+
+typedef struct
+{
+  const char *name;
+  void      (*run) (Image *image);
+} Kernel;
+
+static const Kernel kernels[] =
+{
+  { "nms",               run_nms },
+  { "nms-squared",       run_nms_squared },
+  { "nms-half",          run_nms_half },
+  { "brushfire",         run_brushfire },
+  { "threshold",         run_threshold },
+  { "threshold-squared", run_threshold_squared },
+  { "threshold-half",    run_threshold_half },
+  { "sobel",             run_sobel },
+  { "gradient",          run_gradient },
+  { "gradient-squared",  run_gradient_squared },
+  { "remove-weak-fused", run_remove_weak_fused },
+  { "remove-weak-node",  run_remove_weak_node },
+  { "half-to-float",     run_half_to_float },
+  { "float-to-half",     run_float_to_half },
+  { "area-template",     run_area_template },
+  { "area-strips",       run_area_strips },
+  { "pads-separate",     run_pads_separate },
+  { "pads-shared",       run_pads_shared },
+};
+
+#define N_KERNELS (sizeof (kernels) / sizeof (kernels[0]))
+
+
+/* Print counter id per pixel, or "-" when not available. */
+static void
+print_counter (Counters *counters, CounterId id, const char *label, double per, int width)
+{
+  double value;
+
+  if (counters_read (counters, id, &value))
+    printf (" %s %*.2f", label, width, value / per);
+  else
+    printf (" %s %*s", label, width, "-");
+}
+
+/*
+Run kernel for iterations, after one warm up, and report.
+Counters, unless NULL, count over the same iterations as the times.
+*/
+static void
+bench (const Kernel *kernel, Image *image, int iterations, Counters *counters)
+{
+  double pixels = (double) image->width * image->height;
+  double best   = INFINITY;
+  double total  = 0.0;
+  int    i;
+
+  kernel->run (image);  // Warm the caches, and fault in the pages.
+
+  if (counters != NULL)
+    counters_start (counters);
+
+  for (i = 0; i < iterations; i++)
+    {
+      double start   = now_seconds ();
+      double elapsed;
+
+      kernel->run (image);
+      elapsed = now_seconds () - start;
+
+      total += elapsed;
+      if (elapsed < best)
+        best = elapsed;
+    }
+
+  if (counters != NULL)
+    counters_stop (counters);
+
+  printf ("%-18s %8.2f ns/pixel best %8.2f mean %9.1f Mpixel/s\n",
+          kernel->name,
+          best * 1e9 / pixels,
+          total / iterations * 1e9 / pixels,
+          pixels / best * 1e-6);
+
+  if (counters != NULL)
+    {
+      double per = pixels * iterations;
+      double cycles, instructions, read_misses;
+
+      printf ("%-18s", "");
+      print_counter (counters, COUNTER_CYCLES,        "cycles/px",      per, 7);
+
+      if (counters_read (counters, COUNTER_CYCLES, &cycles) &&
+          counters_read (counters, COUNTER_INSTRUCTIONS, &instructions) &&
+          cycles > 0)
+        printf (" IPC %5.2f", instructions / cycles);
+      else
+        printf (" IPC %5s", "-");
+
+      print_counter (counters, COUNTER_BRANCH_MISSES, "br-miss/px",     per, 6);
+      print_counter (counters, COUNTER_LLC_MISSES,    "LLC-miss/px",    per, 6);
+
+      if (counters_read (counters, COUNTER_LLC_READ_MISSES, &read_misses))
+        printf (" read B/px %6.2f\n", read_misses * CACHE_LINE_BYTES / per);
+      else
+        printf (" read B/px %6s\n", "-");
+    }
+}
+
+
+int
+main (int argc, char **argv)
+{
+  Image    image;
+  Counters counters;
+  int      width        = 2048;
+  int      height       = 2048;
+  int      iterations   = 10;
+  int      workload     = WORKLOAD_RANDOM;
+  char    *pgm_path     = NULL;
+  int      use_counters = 0;
+  int      compare      = 0;
+  int      option;
+  size_t   k;
+
+  while ((option = getopt (argc, argv, "w:h:n:p:o:cH")) != -1)
+    switch (option)
+      {
+      case 'w': width        = atoi (optarg); break;
+      case 'h': height       = atoi (optarg); break;
+      case 'n': iterations   = atoi (optarg); break;
+      case 'p': workload     = workload_of_name (optarg); break;
+      case 'o': pgm_path     = optarg; break;
+      case 'c': use_counters = 1; break;
+      case 'H': compare      = 1; break;
+      default:
+        fprintf (stderr, "Usage: %s [-w WIDTH] [-h HEIGHT] [-n ITERATIONS] [-p WORKLOAD] [-o FILE.pgm] [-c] [-H] [KERNEL...]\n",
+                 argv[0]);
+        return EXIT_FAILURE;
+      }
+
+  if (workload < 0)
+    {
+      fprintf (stderr, "Workloads: random, spiral, weak-noise, texture, sectors\n");
+      return EXIT_FAILURE;
+    }
+
+  if (width <= 0 || height <= 0 || iterations <= 0)
+    {
+      fprintf (stderr, "Width, height, and iterations must be positive\n");
+      return EXIT_FAILURE;
+    }
+
+  image_init (&image, width, height);
+
+  if (workload != WORKLOAD_RANDOM)
+    image_set_workload (&image, workload);
+
+  if (pgm_path != NULL)
+    {
+      int result = workload_write_pgm (image.gradient + (width + 2) * 2 + 2, width, height,
+                                       (ptrdiff_t) (width + 2) * 2, pgm_path);
+
+      if (result != 0)
+        perror (pgm_path);
+
+      image_free (&image);
+      return result == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  printf ("%d x %d, %d iterations, workload %s, kernels %s\n",
+          width, height, iterations, workload_name (workload), bootchk_kernels_isa ());
+
+  if (compare)
+    compare_half (&image);
+
+  if (use_counters)
+    {
+      const char *reason;
+      int         available = counters_open (&counters, &reason);
+
+      if (available == 0)
+        printf ("Counters not available: %s\n", reason);
+      else if (available < N_COUNTERS)
+        printf ("Some counters not available: %s\n", reason);
+    }
+
+  for (k = 0; k < N_KERNELS; k++)
+    {
+      int selected = optind == argc;
+      int i;
+
+      for (i = optind; i < argc; i++)
+        if (strcmp (argv[i], kernels[k].name) == 0)
+          selected = 1;
+
+      if (selected)
+        bench (&kernels[k], &image, iterations, use_counters ? &counters : NULL);
+    }
+
+  if (use_counters)
+    counters_close (&counters);
+
+  image_free (&image);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,161 @@
+#define _GNU_SOURCE  // syscall
+
+#include <string.h>
+
+#include "counters.h"
+
+#ifdef __linux__
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/perf_event.h>
+
+
+typedef struct
+{
+  uint32_t type;
+  uint64_t config;
+} CounterEvent;
+
+static const CounterEvent events[N_COUNTERS] =
+{
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL
+                        | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+};
+
+
+static const char *
+reason_of_errno (int error)
+{
+  switch (error)
+    {
+    case EACCES:
+    case EPERM:      return "not permitted, see /proc/sys/kernel/perf_event_paranoid";
+    case ENOENT:
+    case EOPNOTSUPP: return "event not supported by this CPU";
+    case ENODEV:     return "no performance monitoring unit, e.g. in a VM";
+    case ENOSYS:     return "perf_event_open not in this kernel";
+    default:         return "perf_event_open failed";
+    }
+}
+
+int
+counters_open (Counters *counters, const char **reason)
+{
+  int available = 0;
+  int i;
+
+  *reason = NULL;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    {
+      struct perf_event_attr attr;
+
+      memset (&attr, 0, sizeof (attr));
+      attr.size           = sizeof (attr);
+      attr.type           = events[i].type;
+      attr.config         = events[i].config;
+      attr.disabled       = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      // This thread, any CPU, no group.
+      counters->fd[i] = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+      if (counters->fd[i] >= 0)
+        available++;
+      else if (*reason == NULL)
+        *reason = reason_of_errno (errno);
+    }
+
+  return available;
+}
+
+void
+counters_start (Counters *counters)
+{
+  int i;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    if (counters->fd[i] >= 0)
+      {
+        ioctl (counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl (counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+}
+
+void
+counters_stop (Counters *counters)
+{
+  int i;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    if (counters->fd[i] >= 0)
+      ioctl (counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+}
+
+int
+counters_read (Counters *counters, CounterId id, double *value)
+{
+  uint64_t data[3];  // value, time enabled, time running
+
+  if (counters->fd[id] < 0 ||
+      read (counters->fd[id], data, sizeof (data)) != sizeof (data) ||
+      data[2] == 0)
+    return 0;  // Not available, or never scheduled on the PMU.
+
+  // When more counters than the PMU has, the kernel time slices them: scale up.
+  *value = (double) data[0] * data[1] / data[2];
+
+  return 1;
+}
+
+void
+counters_close (Counters *counters)
+{
+  int i;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    if (counters->fd[i] >= 0)
+      close (counters->fd[i]);
+}
+
+#else
+
+/* Not Linux: no counters. */
+
+int
+counters_open (Counters *counters, const char **reason)
+{
+  int i;
+
+  for (i = 0; i < N_COUNTERS; i++)
+    counters->fd[i] = -1;
+
+  *reason = "perf_event_open is Linux only";
+
+  return 0;
+}
+
+void counters_start (Counters *counters) { (void) counters; }
+void counters_stop  (Counters *counters) { (void) counters; }
+void counters_close (Counters *counters) { (void) counters; }
+
+int
+counters_read (Counters *counters, CounterId id, double *value)
+{
+  (void) counters; (void) id; (void) value;
+
+  return 0;
+}
+
+#endif
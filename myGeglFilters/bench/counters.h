@@ -0,0 +1,50 @@
+/*
+Hardware performance counters of this process, by Linux perf_event_open.
+
+To tell why a kernel is slow: compute (cycles, instructions per cycle),
+branch misses, or memory (last level cache misses, and the bytes they read.)
+
+Each counter is optional.
+Where perf is absent (not Linux, a VM without a PMU,
+or /proc/sys/kernel/perf_event_paranoid too high), a counter is not available,
+and the benchmark reports only time.
+*/
+
+
+typedef enum
+{
+  COUNTER_CYCLES = 0,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_BRANCH_MISSES,
+  COUNTER_LLC_MISSES,
+  COUNTER_LLC_READ_MISSES,
+  N_COUNTERS
+} CounterId;
+
+typedef struct
+{
+  int fd[N_COUNTERS];  // -1 when not available
+} Counters;
+
+
+/*
+Open the counters, of this thread, user space only, stopped.
+Returns the count available, zero when none,
+with the reason of the first failure in *reason (a static string.)
+*/
+int  counters_open  (Counters *counters, const char **reason);
+
+/* Zero and start the available counters. */
+void counters_start (Counters *counters);
+
+/* Stop the available counters. */
+void counters_stop  (Counters *counters);
+
+/*
+Value of counter id since the start, into *value,
+scaled when the kernel multiplexed it with other counters.
+Returns 0 when the counter is not available.
+*/
+int  counters_read  (Counters *counters, CounterId id, double *value);
+
+void counters_close (Counters *counters);
@@ -0,0 +1,245 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "workloads.h"
+
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#define FPP 2 // Floats per pixel, magnitude and direction
+
+#define WEAK   0.4f
+#define STRONG 1.0f
+
+
+static const char *names[N_WORKLOADS] =
+{
+  "random", "spiral", "weak-noise", "texture", "sectors",
+};
+
+
+int
+workload_of_name (const char *name)
+{
+  int i;
+
+  for (i = 0; i < N_WORKLOADS; i++)
+    if (strcmp (name, names[i]) == 0)
+      return i;
+
+  return -1;
+}
+
+const char *
+workload_name (Workload workload)
+{
+  return names[workload];
+}
+
+
+static float
+random_float (unsigned int *seed)
+{
+  *seed = *seed * 1103515245u + 12345u;
+  return (*seed >> 8) / (float) (1 << 24);
+}
+
+static float *
+pixel (float *field, ptrdiff_t stride, int x, int y)
+{
+  return field + y * stride + x * FPP;
+}
+
+
+static void
+fill_random (float *field, int width, int height, ptrdiff_t stride, unsigned seed)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        pixel (field, stride, x, y)[0] = random_float (&seed);
+        pixel (field, stride, x, y)[1] = (random_float (&seed) * 2 - 1) * M_PI;
+      }
+}
+
+/*
+A square spiral, inward, from the top left corner.
+Rings two pixels apart, so no ring is 8-connected to the next,
+and the whole spiral is one chain, about half the pixels long.
+
+The brushfire scans forward, so fire runs along a chain rightward and downward
+in one pass, but leftward and upward only one pixel per pass.
+Half the chain runs leftward or upward:
+the passes are a quarter of the pixels, each pass a scan of the image.
+Quadratic, so bench the spiral at small sizes, e.g. 256 x 256.
+
+The direction is across the chain, as NMS would have kept it.
+*/
+static void
+fill_spiral (float *field, int width, int height, ptrdiff_t stride)
+{
+  static const int dx[4] = { 1, 0, -1, 0 };  // right, down, left, up
+  static const int dy[4] = { 0, 1, 0, -1 };
+  int x = 0, y = 0, d = 0;
+  int turns = 0;
+
+  pixel (field, stride, x, y)[0] = STRONG;
+  pixel (field, stride, x, y)[1] = M_PI / 2;
+
+  /* Advance while the next pixel is inside and free, and the one after is not on the chain. */
+  while (turns < 2)
+    {
+      int nx = x + dx[d], ny = y + dy[d];
+      int fx = nx + dx[d], fy = ny + dy[d];
+
+      if (nx < 0 || nx >= width || ny < 0 || ny >= height ||
+          pixel (field, stride, nx, ny)[0] != 0 ||
+          (fx >= 0 && fx < width && fy >= 0 && fy < height &&
+           pixel (field, stride, fx, fy)[0] != 0))
+        {
+          d = (d + 1) % 4;  // Turn right; blocked twice is the center.
+          turns++;
+          continue;
+        }
+
+      x = nx;
+      y = ny;
+      turns = 0;
+      pixel (field, stride, x, y)[0] = WEAK;
+      pixel (field, stride, x, y)[1] = dx[d] != 0 ? M_PI / 2 : 0;
+    }
+}
+
+/*
+Every pixel weak, one 8-connected blob, and strong only the last pixel.
+Fire starts at the bottom right, and climbs one row per pass:
+as many passes as rows, each pass a scan with every pixel weak.
+*/
+static void
+fill_weak_noise (float *field, int width, int height, ptrdiff_t stride, unsigned seed)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        // Weak in (0.3, 0.5], above the usual weak threshold, unchanged by it.
+        pixel (field, stride, x, y)[0] = 0.5f - 0.19f * random_float (&seed);
+        pixel (field, stride, x, y)[1] = (random_float (&seed) * 2 - 1) * M_PI;
+      }
+
+  pixel (field, stride, width - 1, height - 1)[0] = STRONG;
+}
+
+/*
+A fine texture, the product of two sinusoids, periods of a few pixels.
+Edges everywhere: many local maxima for NMS, many weak and strong for hysteresis.
+The direction is of the analytic gradient, y up.
+*/
+static void
+fill_texture (float *field, int width, int height, ptrdiff_t stride)
+{
+  const double fx = 2 * M_PI / 5;
+  const double fy = 2 * M_PI / 7;
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        double gx = fx * cos (fx * x) * sin (fy * y);
+        double gy = fy * sin (fx * x) * cos (fy * y);
+
+        pixel (field, stride, x, y)[0] = 0.5 + 0.5 * sin (fx * x) * sin (fy * y);
+        pixel (field, stride, x, y)[1] = atan2 (-gy, gx);
+      }
+}
+
+/*
+Directions on the boundaries between the sectors of NMS, 22.5 + 45 k degrees,
+or an ulp either side, at random.
+The sector of each pixel is unpredictable, to the branch predictor too,
+and a sector computed carelessly, e.g. in different precision, shows as a change of output.
+*/
+static void
+fill_sectors (float *field, int width, int height, ptrdiff_t stride, unsigned seed)
+{
+  int x, y;
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        int   k         = (int) (random_float (&seed) * 8);
+        float boundary  = (float) ((22.5 + 45 * k) * M_PI / 180 - (k >= 4 ? 2 * M_PI : 0));
+        float side      = random_float (&seed);
+
+        if (side < 1 / 3.0f)
+          boundary = nextafterf (boundary, -INFINITY);
+        else if (side < 2 / 3.0f)
+          boundary = nextafterf (boundary, INFINITY);
+
+        pixel (field, stride, x, y)[0] = random_float (&seed);
+        pixel (field, stride, x, y)[1] = boundary;
+      }
+}
+
+
+void
+workload_fill (
+  Workload  workload,
+  float    *field,
+  int       width,
+  int       height,
+  ptrdiff_t stride,
+  unsigned  seed)
+{
+  int y;
+
+  for (y = 0; y < height; y++)
+    memset (field + y * stride, 0, (size_t) width * FPP * sizeof (float));
+
+  switch (workload)
+    {
+    case WORKLOAD_SPIRAL:     fill_spiral (field, width, height, stride);           break;
+    case WORKLOAD_WEAK_NOISE: fill_weak_noise (field, width, height, stride, seed); break;
+    case WORKLOAD_TEXTURE:    fill_texture (field, width, height, stride);          break;
+    case WORKLOAD_SECTORS:    fill_sectors (field, width, height, stride, seed);    break;
+    case WORKLOAD_RANDOM:
+    default:                  fill_random (field, width, height, stride, seed);     break;
+    }
+}
+
+
+int
+workload_write_pgm (
+  const float *field,
+  int          width,
+  int          height,
+  ptrdiff_t    stride,
+  const char  *path)
+{
+  FILE *file = fopen (path, "wb");
+  int   x, y;
+
+  if (file == NULL)
+    return -1;
+
+  fprintf (file, "P5\n%d %d\n65535\n", width, height);
+
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      {
+        float    magnitude = field[y * stride + x * FPP];
+        unsigned value     = (unsigned) (fminf (fmaxf (magnitude, 0), 1) * 65535 + 0.5f);
+
+        // PGM samples are big-endian.
+        fputc (value >> 8, file);
+        fputc (value & 0xff, file);
+      }
+
+  return fclose (file) == 0 ? 0 : -1;
+}
@@ -0,0 +1,49 @@
+/*
+Synthetic workloads for the benchmark: gradient fields of any size,
+shaped to the worst cases of non-max suppression and hysteresis.
+
+A field is pixels of two floats, magnitude and direction,
+as the output of the gradient, the input of NMS.
+The magnitudes of the hysteresis workloads are already double thresholded,
+as the input of hysteresis: 0 none, in (0, 0.5] weak, 1.0 strong.
+*/
+
+#include <stddef.h>
+
+
+typedef enum
+{
+  WORKLOAD_RANDOM = 0,  // uniform random magnitudes and directions
+  WORKLOAD_SPIRAL,      // one long weak chain, a square spiral, strong at its outer end
+  WORKLOAD_WEAK_NOISE,  // every pixel weak, strong only the last pixel
+  WORKLOAD_TEXTURE,     // dense fine texture, edges everywhere
+  WORKLOAD_SECTORS,     // directions on the boundaries of the NMS sectors
+  N_WORKLOADS
+} Workload;
+
+/* The workload named name, or -1. */
+int         workload_of_name (const char *name);
+
+const char *workload_name    (Workload workload);
+
+/*
+Fill width x height pixels of field, rows stride floats apart.
+Deterministic for a seed, so runs are comparable.
+*/
+void        workload_fill    (Workload  workload,
+                              float    *field,
+                              int       width,
+                              int       height,
+                              ptrdiff_t stride,
+                              unsigned  seed);
+
+/*
+Write the magnitude channel of a field to path, as a 16-bit PGM,
+to view it, or to feed the GEGL ops (gegl:load reads PGM).
+Returns 0 on success, else -1 with errno set.
+*/
+int         workload_write_pgm (const float *field,
+                                int          width,
+                                int          height,
+                                ptrdiff_t    stride,
+                                const char  *path);
@@ -0,0 +1,52 @@
+/*
+The module entry points of the bundle of ops, see meson.build.
+
+GEGL calls these when it loads the module, as for any plug-in.
+Registering registers each op, by the function gegl-op.h defined for it,
+named by the op's GEGL_OP_NAME.
+*/
+
+#include <gegl.h>
+#include <gegl-plugin.h>
+
+
+void gegl_op_canny_op_register_type                  (GTypeModule *module);
+void gegl_op_double_threshold_op_register_type       (GTypeModule *module);
+void gegl_op_non_max_gradient_suppress_register_type (GTypeModule *module);
+void gegl_op_hysteresis_register_type                (GTypeModule *module);
+void gegl_op_edge_chains_register_type               (GTypeModule *module);
+void gegl_op_false_color_op_register_type            (GTypeModule *module);
+void gegl_op_false_color_gradient_op_register_type   (GTypeModule *module);
+void gegl_op_my_image_gradient_register_type         (GTypeModule *module);
+void gegl_op_hacked_edge_sobel_register_type         (GTypeModule *module);
+
+
+static const GeglModuleInfo modinfo =
+{
+  GEGL_MODULE_ABI_VERSION
+};
+
+G_MODULE_EXPORT const GeglModuleInfo *
+gegl_module_query (GTypeModule *module)
+{
+  return &modinfo;
+}
+
+G_MODULE_EXPORT gboolean
+gegl_module_register (GTypeModule *module)
+{
+  // Canny and the primitives it uses
+  gegl_op_my_image_gradient_register_type (module);
+  gegl_op_non_max_gradient_suppress_register_type (module);
+  gegl_op_double_threshold_op_register_type (module);
+  gegl_op_hysteresis_register_type (module);
+  gegl_op_canny_op_register_type (module);
+
+  gegl_op_edge_chains_register_type (module);
+
+  gegl_op_hacked_edge_sobel_register_type (module);
+  gegl_op_false_color_op_register_type (module);
+  gegl_op_false_color_gradient_op_register_type (module);
+
+  return TRUE;
+}
@@ -19,8 +19,41 @@ property_double (strong_threshold, "Strong threshold", 0.8)
   value_range   (0.0, 1.0)
   ui_meta       ("unit", "pixel-distance")
 
-// property_boolean (should_remove_weak, "Hide weak values", TRUE)
-//  description   ("Show middle gray values, or set to black")
+property_int (strip_height, "Strip height", 0)
+  description   ("Rows per strip of hysteresis, for images too large for memory. "
+                 "Zero processes the whole image in memory.")
+  value_range   (0, 65536)
+  ui_range      (0, 4096)
+
+property_boolean (should_remove_weak, "Hide weak values", TRUE)
+  description   ("Set weak values not promoted to black, or show them middle gray")
+
+property_boolean (half_precision, "Half precision", FALSE)
+  description   ("Store the gradient, non-max suppression, and threshold results "
+                 "as half floats, half the memory traffic. "
+                 "Edges can differ at a few pixels whose magnitudes are near a threshold or a neighbor's.")
+
+property_boolean (skip_transparent, "Skip transparent", FALSE)
+  description   ("No edges where the image is fully transparent, "
+                 "and skip the work there, e.g. the margins of a cut-out. "
+                 "Off by default, as canny was: edges of the color under alpha 0 too.")
+
+property_boolean (alpha_edges, "Alpha edges", FALSE)
+  description   ("Also an edge along the boundary of the opaque region, "
+                 "as if the transparent region were black.")
+
+enum_start (bootchk_canny_quality)
+  enum_value (BOOTCHK_CANNY_QUALITY_FINAL, "final", "Final")
+  enum_value (BOOTCHK_CANNY_QUALITY_DRAFT, "draft", "Draft")
+enum_end (BootchkCannyQuality)
+
+property_enum (quality, "Quality",
+               BootchkCannyQuality, bootchk_canny_quality,
+               BOOTCHK_CANNY_QUALITY_FINAL)
+  description   ("Final is exact. Draft is fast, for a live preview while dragging a slider: "
+                 "a recursive blur, and hysteresis of a few passes over only the view, "
+                 "so some weak edges far along a chain from a strong edge are missing. "
+                 "Set final before committing: the filter applies as previewed.")
 
 #else
 
@@ -37,6 +70,25 @@ property_double (strong_threshold, "Strong threshold", 0.8)
 #include "gegl-op.h"
 
 // There is no way to include enum definitions private to gegl:image-gradient
+// Nor gegl:gaussian-blur's: its filter property, 0 auto, 2 IIR.
+#define BLUR_FILTER_AUTO 0
+#define BLUR_FILTER_IIR  2
+
+/*
+Passes of hysteresis in draft quality.
+Each pass costs about one brushfire pass over the view,
+and promotes along a chain at least a pixel, usually a run, in scan order.
+Most weak pixels of a photo are a few pixels from a strong one.
+*/
+#define DRAFT_HYSTERESIS_PASSES 4
+
+
+/* The interior nodes that quality changes, see update. */
+typedef struct
+{
+  GeglNode *blur_node;
+  GeglNode *hysteresis_node;
+} State;
 
 
 /* Return a Gegl node that converts an image to grayscale.
@@ -111,21 +163,31 @@ make_edge_detect_node (GeglNode *gegl)
   Note that image-gradient internally converts to format RGB, dropping alpha.
   See the source code for gegl:image-gradient.
   The output is a 2-channel image.
+
+  bootchk:my-image-gradient is gegl:image-gradient hacked, see hacked/image-gradient.c.
+  Squared: the magnitude channel is the square of the magnitude, no sqrt per pixel.
+  The following steps only compare magnitudes, to each other and to thresholds,
+  and compare squares exactly as they would the magnitudes,
+  so the edges are the same as without squaring.
   */
   return gegl_node_new_child (
     gegl, 
-    "operation",   "gegl:image-gradient",
+    "operation",   "bootchk:my-image-gradient",
     "output-mode", 2, // FAIL: "both", GEGL_IMAGEGRADIENT_BOTH, // both magnitude and direction
+    "squared",     TRUE,
     NULL);
 
   #endif
 }
 
-/* Return a Gegl node that thins edges. */
+/* Return a Gegl node that thins edges, of the squared magnitudes. */
 GeglNode *
 make_edge_thinning_node (GeglNode *gegl)
 {
-  return gegl_node_new_child (gegl, "operation", "bootchk:non-max-gradient-suppress", NULL);
+  return gegl_node_new_child (gegl,
+                              "operation", "bootchk:non-max-gradient-suppress",
+                              "squared",   TRUE,
+                              NULL);
 }
 
 
@@ -134,58 +196,57 @@ See double-threshold-op.c for the definition of this operation.
 Keeps middle gray values.
 Changes lower values to black 
 Changes higher values to white.
+
+Its input is squared magnitudes, it squares the thresholds internally,
+so the weak and strong thresholds of canny are still of the magnitude.
+Its output is the magnitude again, for hysteresis.
 */
 GeglNode *
 make_threshold_node (GeglNode *gegl)
 {
-  return gegl_node_new_child (gegl,  "operation", "bootchk:double-threshold", NULL);
-}
-
-GeglNode *
-make_hysteresis_node (GeglNode *gegl)
-{
-  return gegl_node_new_child (gegl, "operation", "bootchk:hysteresis", NULL);
+  return gegl_node_new_child (gegl,
+                              "operation", "bootchk:double-threshold",
+                              "squared",   TRUE,
+                              NULL);
 }
 
 /*
-Make a node to remove (to black) the weak values.
-This hides a choice of implementation.
-Here we use double-threshold, since we already used it.
-Alternatively, we could use a simple threshold.
-
-Later we set the low and high thresholds to the same value, strong-threshold,
-which effectively removes the weak values.
-This is a trick to make the double threshold into a single threshold.
+Hysteresis also removes (to black) the weak values not promoted,
+see its remove-weak property.
+Formerly a second double-threshold did that,
+with both thresholds at strong-threshold,
+at the cost of another node, buffer, and pass over the whole image.
 */
 GeglNode *
-make_weak_remove_node (GeglNode *gegl)
+make_hysteresis_node (GeglNode *gegl)
 {
-  return gegl_node_new_child (gegl,
-                              "operation", "bootchk:double-threshold",
-                              "low-threshold", 0.5, // moot, changed later
-                              "high-threshold", 0.5,
-                              NULL);
+  return gegl_node_new_child (gegl, "operation", "bootchk:hysteresis", NULL);
 }
 
 
 
 
-
 /* Create a graph of operations.
  * No code here to construct any specific primitive operations, i.e. node. 
  * They are constructed in separate functions.
  */
+static void update (GeglOperation *operation);
+
 static void
 attach (GeglOperation *operation)
 {
-  GeglNode *gegl = operation->node;
-
-  // gboolean should_remove_weak = GEGL_PROPERTIES (operation)->should_remove_weak;
+  GeglNode       *gegl  = operation->node;
+  GeglProperties *o     = GEGL_PROPERTIES (operation);
+  State          *state = g_new0 (State, 1);
 
   // Nodes with params redirected to self's params.
   GeglNode *threshold_node = make_threshold_node (gegl);
   GeglNode *blur_node      = make_blur_node (gegl, 3.0);
-  GeglNode *final_threshold_node = make_weak_remove_node (gegl);
+  GeglNode *hysteresis_node = make_hysteresis_node (gegl);
+
+  // Nodes with outputs also exported, see below.
+  GeglNode *gradient_node  = make_edge_detect_node (gegl);
+  GeglNode *thinning_node  = make_edge_thinning_node (gegl);
 
   /* Call variadic function to link operations,
    * i.e. create a graph that is a sequence i.e. chain.
@@ -207,29 +268,42 @@ attach (GeglOperation *operation)
     blur_node,
 
     // sobel edge detection. Result edges are thick.
-    make_edge_detect_node (gegl),
-    // format is now float[2], i.e. channels magnitude and direction.
+    gradient_node,
+    // format is now float[2], i.e. channels magnitude squared and direction.
     // Note we have lost any alpha channel, it is not needed for edges.
+    // The same format, bootchk_gradient_format, through the input of hysteresis:
+    // no babl conversion between these nodes.
 
     // Thin edges, aka non maximum suppression.
-    make_edge_thinning_node (gegl),
+    thinning_node,
 
     // TODO discard direction channel,
 
-    // double threshold magnitude channel
+    // double threshold magnitude channel, back to magnitude from squared
     threshold_node,
 
-    // hysteresis edge tracking
-    make_hysteresis_node (gegl),
+    // hysteresis edge tracking, and removing weak values not promoted
+    hysteresis_node,
 
-    final_threshold_node,
-
-    // Image is grayscale
+    // Image is grayscale, format Y'A float, converted once as hysteresis writes it
     // We don't convert to indexed color, black and white
 
     gegl_node_get_output_proxy (gegl, "output"),
     NULL);
 
+  /*
+  Extra output pads, of intermediate results,
+  so a graph needing them too shares the one gradient computation, not repeating it.
+  Both are float[2] (half[2] when half-precision), magnitude squared and direction:
+  "gradient" is the thick edges, "nms" the thinned edges.
+  Consumers must take the magnitude as squared: bootchk:false-color-filter,
+  non-max-gradient-suppress, and double-threshold have a squared property for it.
+  GEGL computes a pad only when something downstream reads it,
+  and caches the gradient and NMS nodes, so reading all pads computes each once.
+  */
+  gegl_node_link (gradient_node, gegl_node_get_output_proxy (gegl, "gradient"));
+  gegl_node_link (thinning_node, gegl_node_get_output_proxy (gegl, "nms"));
+
   /* Redirect this meta op's properties
    * to the interior node's properties.
    */
@@ -242,23 +316,93 @@ attach (GeglOperation *operation)
   gegl_operation_meta_redirect (operation, "weak-threshold",   threshold_node, "low-threshold");
   gegl_operation_meta_redirect (operation, "strong-threshold", threshold_node, "high-threshold");
 
-  /* Redirect the strong-threshold to both params of the final threshold node.
-   * This is a trick to make the double-threshold into a single threshold.
-   * This removes the weak values.
-   */
-  gegl_operation_meta_redirect (operation, "strong-threshold", final_threshold_node, "low-threshold");
-  gegl_operation_meta_redirect (operation, "strong-threshold", final_threshold_node, "high-threshold");
+  /* Hysteresis removes the weak values, its output is the final binary result. */
+  gegl_operation_meta_redirect (operation, "should-remove-weak", hysteresis_node, "remove-weak");
+
+  /* Streaming strips bounds the memory of hysteresis, the only whole-image step. */
+  gegl_operation_meta_redirect (operation, "strip-height", hysteresis_node, "strip-height");
+
+  /*
+  Half floats between the stages from the gradient through hysteresis,
+  each stage declaring the same format, so still no conversion between them.
+  Gray and blur are GEGL's, computing in float.
+  */
+  gegl_operation_meta_redirect (operation, "half-precision", gradient_node,   "half");
+  gegl_operation_meta_redirect (operation, "half-precision", thinning_node,   "half");
+  gegl_operation_meta_redirect (operation, "half-precision", threshold_node,  "half");
+  gegl_operation_meta_redirect (operation, "half-precision", hysteresis_node, "half");
+
+  /*
+  Cut-outs: the gradient reads alpha, which gray and blur keep,
+  and outputs zero where all is transparent, skipping the strips all transparent.
+  Downstream, NMS copies the chunks all black, and hysteresis burns only within
+  the bounds of the pixels not black, so they skip the transparent margins too.
+  */
+  gegl_operation_meta_redirect (operation, "skip-transparent", gradient_node, "skip-transparent");
+  gegl_operation_meta_redirect (operation, "alpha-edges",      gradient_node, "premultiplied");
+
+  /* Quality is not one property of one node, update sets the nodes from it. */
+  o->user_data = state;
+  state->blur_node       = blur_node;
+  state->hysteresis_node = hysteresis_node;
+  update (operation);
+}
+
+
+/*
+Set the interior nodes from quality.
+Called on attach, and by GEGL when a property of canny changes.
+
+Draft, for GIMP's live preview:
+the blur is IIR, a cost per pixel independent of the blur amount,
+and hysteresis is bounded to a few passes, and local,
+so GEGL computes the whole chain for only the view, not the whole image.
+Nothing here, nor in GIMP, switches to final on commit:
+GIMP applies a filter with the properties it previewed.
+So whoever drives the preview sets quality final before committing,
+as bootchk-batch --preview does, which also times draft renders against a 30 ms budget.
+*/
+static void
+update (GeglOperation *operation)
+{
+  GeglProperties *o     = GEGL_PROPERTIES (operation);
+  State          *state = o->user_data;
+  gboolean        draft = o->quality == BOOTCHK_CANNY_QUALITY_DRAFT;
+
+  if (state == NULL)
+    return;  // Not attached yet.
+
+  gegl_node_set (state->blur_node,
+                 "filter", draft ? BLUR_FILTER_IIR : BLUR_FILTER_AUTO,
+                 NULL);
+  gegl_node_set (state->hysteresis_node,
+                 "max-passes", draft ? DRAFT_HYSTERESIS_PASSES : 0,
+                 NULL);
+}
+
+
+static void
+finalize (GObject *object)
+{
+  GeglProperties *o = GEGL_PROPERTIES (object);
+
+  g_clear_pointer (&o->user_data, g_free);
 
+  G_OBJECT_CLASS (gegl_op_parent_class)->finalize (object);
 }
 
 
 static void
 gegl_op_class_init (GeglOpClass *klass)
 {
-  GeglOperationClass *operation_class = GEGL_OPERATION_CLASS (klass);
+  GObjectClass           *object_class    = G_OBJECT_CLASS (klass);
+  GeglOperationClass     *operation_class = GEGL_OPERATION_CLASS (klass);
+  GeglOperationMetaClass *meta_class      = GEGL_OPERATION_META_CLASS (klass);
 
   // Override superclasses attach method.
   operation_class->attach = attach;
+  meta_class->update      = update;
+  object_class->finalize  = finalize;
 
   gegl_operation_class_set_keys (operation_class,
                                  "title",       "Canny edge detect filter",
@@ -266,7 +410,11 @@ gegl_op_class_init (GeglOpClass *klass)
                                  "blurb",       "Generate b/w, thinned edges from an image",
                                  "version",     "0.1",
                                  "categories",  "edge-detect",
-                                 "description", "Canny filter",
+                                 "description", "Canny filter. "
+                                                "Also outputs its gradient and thinned gradient, "
+                                                "pads gradient and nms, magnitude squared "
+                                                "(false-color-filter squared=true shows them). "
+                                                "Quality draft is fast, approximate, for previews.",
                                  "author",      "lloyd konneker",
                                  NULL);
 }
@@ -10,6 +10,14 @@ property_double (high_threshold, "High Threshold", 0.66)
     ui_range    (0, 1)
     description("Values above this become white.")
 
+property_boolean (squared, "Squared input", FALSE)
+    description("The first channel is a squared magnitude, as from a gradient without the square root. "
+                "The thresholds are still of the magnitude, the values between are output as magnitudes.")
+
+property_boolean (half, "Half floats", FALSE)
+    description("Input and output are IEEE half floats, half the bytes, thresholded in float. "
+                "Otherwise the input's own format, when a type and channels the kernels have.")
+
 #else
 
 // Boilerplate code for a GEGL operation
@@ -23,19 +31,32 @@ property_double (high_threshold, "High Threshold", 0.66)
 // Base on the above definitions, gegl-op.h generates code for the operation
 #include "gegl-op.h"
 
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-trace.h"
+#include "point-format.h"
 
+
+/*
+The format of the source, the narrowest the graph gives, when the kernels have a loop for it:
+in canny, the gradient format of the stages before and after, float or half,
+no conversion between them. A color image is converted to Y'A of its type,
+the luminance thresholded, see bootchk_point_format.
+Without a source, the gradient format.
+*/
 static void prepare (GeglOperation *operation)
 {
-  const Babl *space = gegl_operation_get_source_space (operation, "input");
-  // TODO float 2 format is not defined in babl, so we use Y'A float.
-  gegl_operation_set_format (operation, "input",  babl_format_with_space ("Y'A float", space));
-  gegl_operation_set_format (operation, "output", babl_format_with_space ("Y'A float", space));
+  const Babl *space  = gegl_operation_get_source_space (operation, "input");
+  const Babl *source = gegl_operation_get_source_format (operation, "input");
+  const Babl *format = GEGL_PROPERTIES (operation)->half
+                       ? bootchk_gradient_half_format ()
+                       : bootchk_point_format (source, space, bootchk_gradient_format ());
+
+  gegl_operation_set_format (operation, "input",  format);
+  gegl_operation_set_format (operation, "output", format);
 }
 
 
-#define FPP 2 // Floats per pixel for the input format
-
-
 /*
 Transform function, where horizontal axis is the first channel value,
 vertical axis is the output value.
@@ -49,7 +70,7 @@ vertical axis is the output value.
 
 Thresholds the first channel of each pixel in the input buffer.
 
-The input and output have two channels.
+The input and output have one, two, or four channels.
 
 A typical use case: first channel is luminance and the second is alpha (Y'A).
 Another use case is a gradient field, 
@@ -65,9 +86,10 @@ When the high threshold is less than or equal to the low threshold,
 the transform function is a simple step function 
 having a step at the low threshold.
 
-The input buffer is expected to be in the format Y'A float.
-The output buffer is also in the format Y'A float.
-The input and output buffers have two channels per pixel, hence the stride of 2.
+In canny, the input and output buffers are in the gradient format, float[2] or half[2],
+see gradient-format.h, as are the stages of canny before and after.
+Otherwise in the format of the source when gray, e.g. Y'A u8, or Y'A of a color, see prepare:
+integer channels are normalized to [0, 1] for the thresholds, as babl does.
 
 The operation processes each pixel independently, hence it is a point filter.
 Process each pixel in a single pass.
@@ -78,6 +100,16 @@ set to white (1.0) if above the high threshold, and otherwise keeps the original
 
 This is a simple thresholding operation that can be used for various effects,
 such as creating a binary mask or isolating certain brightness levels in an image.
+
+When squared, the first channel is a squared magnitude.
+The thresholds are squared to match, exactly, see bootchk_squared_threshold,
+and the values kept are output as magnitudes.
+So the output is the same as thresholding the magnitudes,
+and the square roots are only of the values kept.
+
+The loop is of bootchk_threshold_point, in the kernels library,
+for the type and channels of the format, see bootchk-point.h.
+When half, the pixels are converted to floats and back, a block at a time.
  */
 static gboolean
 process (GeglOperation       *op,
@@ -87,33 +119,28 @@ process (GeglOperation       *op,
          const GeglRectangle *roi,
          gint                 level)
 {
-  // Pointers to scan buffer.
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-
   // Get low and high thresholds from the operation properties.
-  gfloat low_threshold  = GEGL_PROPERTIES (op)->low_threshold;
-  gfloat high_threshold = GEGL_PROPERTIES (op)->high_threshold;
-  
-  
-  for (glong i=0; i<n_pixels; i++)
-    {
-      gfloat c = in[0];
-  
-      if (c < low_threshold)
-        out[0] = 0; // Set to black when below low threshold
-      else if (c > high_threshold)
-        out[0] = 1; // Set to white when above high threshold
-      else  // Otherwise, keep original value
-        out[0] = in[0];
-          
-      // Copy second channel unchanged.
-      out[1] = in[1];
-
-      // Move to the next pixel.
-      in  += FPP;
-      out += FPP;
-    }
+  BootchkThresholdParams params  = { GEGL_PROPERTIES (op)->low_threshold,
+                                     GEGL_PROPERTIES (op)->high_threshold };
+  gboolean               squared = GEGL_PROPERTIES (op)->squared;
+  const Babl            *format  = gegl_operation_get_format (op, "input");
+  BootchkPointFunc       loop;
+  OpTrace                trace;
+
+  // The loop of the format prepare negotiated, by its type and channels.
+  loop = bootchk_threshold_point (bootchk_point_type (format),
+                                  babl_format_get_n_components (format),
+                                  squared);
+  g_return_val_if_fail (loop != NULL, FALSE);
+
+  op_trace_begin (&trace, op, roi);
+
+  if (squared)
+    bootchk_squared_threshold (params.low, params.high, &params.low, &params.high);
+
+  loop (in_buf, out_buf, n_pixels, &params);
+
+  op_trace_end (&trace);
 
   return TRUE;
 }
@@ -133,6 +160,9 @@ gegl_op_class_init (GeglOpClass *klass)
   point_filter_class->process = process;
   operation_class->prepare    = prepare;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
                                  "title",       "Double threshold filter",
                                  "name",        "bootchk:double-threshold",
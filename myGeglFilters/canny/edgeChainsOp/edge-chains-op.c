@@ -0,0 +1,130 @@
+/*
+Trace edges into chains: ordered polylines.
+Saves the chains to a JSON file.
+
+Typically used after canny, on its white edges on black.
+Downstream consumers then get contours directly,
+instead of vectorizing the edge raster again.
+
+Chains shorter than the minimum length are dropped,
+e.g. fragments of noise.
+
+See edge-chains.c for the tracing algorithm and the JSON layout.
+*/
+
+
+#ifdef GEGL_PROPERTIES
+
+property_file_path (path, "File", "edge-chains.json")
+  description ("Path of the JSON file to save the chains to")
+
+property_double (min_length, "Minimum length", 0.0)
+  description ("Chains shorter than this, in pixels, are dropped")
+  value_range (0.0, 100000.0)
+  ui_range    (0.0, 100.0)
+  ui_meta     ("unit", "pixel-distance")
+
+#else
+
+// Boilerplate code for a GEGL operation
+
+// Declare is a op of type GEGL_OP_SINK
+// A sink operation consumes its input, it has no output pad.
+#define GEGL_OP_SINK
+#define GEGL_OP_NAME     edge_chains
+#define GEGL_OP_C_SOURCE edge-chains-op.c
+
+// Base on the above definitions, gegl-op.h generates code for the operation
+#include "gegl-op.h"
+
+#include "op-progress.h"
+#include "op-trace.h"
+#include "edge-chains.h"
+
+
+
+static void prepare (GeglOperation *operation)
+{
+  const Babl *space = gegl_operation_get_source_space (operation, "input");
+
+  // Same format as the output of canny, Y' is the edge channel.
+  gegl_operation_set_format (operation, "input", babl_format_with_space ("Y'A float", space));
+}
+
+
+/* Has type of SinkClass.Process */
+static gboolean
+process (GeglOperation       *operation,
+         GeglBuffer          *input,
+         const GeglRectangle *rect,
+         gint                 level)
+{
+  GeglProperties *o      = GEGL_PROPERTIES (operation);
+  GError         *error  = NULL;
+  GPtrArray      *chains;
+  OpProgress      progress;
+  OpTrace         trace;
+  gboolean        completed;
+  guint           i;
+
+  op_trace_begin (&trace, operation, rect);
+  op_progress_begin (&progress, operation, rect);
+
+  chains = edge_chains_trace (input, rect,
+                              gegl_operation_get_format (operation, "input"),
+                              o->min_length,
+                              &progress);
+
+  // Don't overwrite the file with chains of a stale render.
+  if (! op_progress_is_cancelled (&progress) &&
+      ! edge_chains_write_json (chains, rect, o->path, &error))
+    {
+      g_warning ("%s: %s", G_STRFUNC, error->message);
+      g_error_free (error);
+    }
+
+  // The mask of edge pixels, and the points of the chains kept.
+  op_trace_bytes (&trace, (gsize) rect->width * rect->height);
+  for (i = 0; i < chains->len; i++)
+    op_trace_bytes (&trace, ((EdgeChain *) g_ptr_array_index (chains, i))->points->len
+                            * sizeof (EdgeChainPoint));
+
+  g_ptr_array_free (chains, TRUE);
+
+  completed = op_progress_end (&progress);
+  op_trace_end (&trace);
+
+  return completed;
+}
+
+static void
+gegl_op_class_init (GeglOpClass *klass)
+{
+  // The base class of all GEGL operations is GeglOperation.
+  GeglOperationClass *operation_class = GEGL_OPERATION_CLASS (klass);
+
+  // The parent class for sinks is GeglOperationSinkClass.
+  GeglOperationSinkClass *sink_class = GEGL_OPERATION_SINK_CLASS (klass);
+
+  // Override superclass methods.
+  operation_class->prepare = prepare;
+  sink_class->process      = process;
+
+  /*
+  Chains can cross any chunk boundary,
+  so process the whole input at once.
+  */
+  sink_class->needs_full = TRUE;
+
+  gegl_operation_class_set_keys (operation_class,
+    "title",       "Edge chains",
+    "name",        "bootchk:edge-chains",
+    "blurb",       "Trace edges into polylines, saved as JSON.",
+    "version",     "0.1",
+    "categories",  "edge-detect",
+    "description", "Trace connected edge pixels into ordered chains, with lengths.",
+    "author",      "lloyd konneker",
+    NULL);
+}
+
+#endif
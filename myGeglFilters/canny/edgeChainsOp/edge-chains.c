@@ -0,0 +1,341 @@
+#include <gegl.h>
+#include <math.h>
+
+#include "op-progress.h"
+#include "edge-chains.h"
+
+
+
+
+#define FPP 2 // Floats per pixel for the input format (Y'A float has 2 channels)
+
+/*
+The mask of edge pixels, one byte per pixel.
+Tracing marks pixels visited, so each edge pixel joins exactly one chain.
+*/
+#define MASK_EDGE    0x01
+#define MASK_VISITED 0x02
+
+/* Does pixel have magnitude with criteria "edge", i.e. white. */
+#define is_edge_magnitude(magnitude) \
+  ((magnitude) > 0.5)
+
+/*
+Offsets to the eight neighbors.
+The four axial neighbors first, so a walk prefers them over diagonals.
+Otherwise at a staircase corner the walk would cut the corner
+and leave the corner pixel to start a chain of its own.
+*/
+static const gint neighbor_dx[8] = { 1, 0, -1,  0, 1, -1, -1,  1 };
+static const gint neighbor_dy[8] = { 0, 1,  0, -1, 1,  1, -1, -1 };
+
+
+/* Count of edge pixels among the eight neighbors of pixel at x, y. */
+static gint
+count_edge_neighbors (
+  const guint8 *mask,
+  gint          width,
+  gint          height,
+  gint          x,
+  gint          y)
+{
+  gint count = 0;
+  gint i;
+
+  for (i = 0; i < 8; i++)
+    {
+      gint nx = x + neighbor_dx[i];
+      gint ny = y + neighbor_dy[i];
+
+      if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
+          (mask[ny * width + nx] & MASK_EDGE))
+        count++;
+    }
+
+  return count;
+}
+
+/*
+Walk from pixel at x, y along unvisited edge pixels,
+appending each pixel stepped to onto points.
+Stops when no neighbor is an unvisited edge pixel.
+Each step looks at eight neighbors, so a walk is linear in its length.
+*/
+static void
+walk (
+  guint8 *mask,
+  gint    width,
+  gint    height,
+  gint    x,
+  gint    y,
+  GArray *points)
+{
+  for (;;)
+    {
+      gint i;
+
+      for (i = 0; i < 8; i++)
+        {
+          gint nx = x + neighbor_dx[i];
+          gint ny = y + neighbor_dy[i];
+
+          if (nx >= 0 && nx < width && ny >= 0 && ny < height &&
+              mask[ny * width + nx] == MASK_EDGE)
+            break;
+        }
+
+      if (i == 8)
+        return;  // Dead end, or all neighbors already in chains.
+
+      x += neighbor_dx[i];
+      y += neighbor_dy[i];
+      mask[y * width + x] |= MASK_VISITED;
+
+      {
+        EdgeChainPoint point = { x, y };
+
+        g_array_append_val (points, point);
+      }
+    }
+}
+
+/*
+Trace the chain through the unvisited edge pixel at x, y.
+Walks both ways from the pixel, then joins the two walks into one polyline.
+*/
+static EdgeChain *
+trace_chain (
+  guint8 *mask,
+  gint    width,
+  gint    height,
+  gint    x,
+  gint    y)
+{
+  EdgeChain     *chain    = g_new0 (EdgeChain, 1);
+  GArray        *backward = g_array_new (FALSE, FALSE, sizeof (EdgeChainPoint));
+  EdgeChainPoint start    = { x, y };
+  guint          i;
+
+  chain->points = g_array_new (FALSE, FALSE, sizeof (EdgeChainPoint));
+
+  mask[y * width + x] |= MASK_VISITED;
+
+  walk (mask, width, height, x, y, backward);
+
+  /* Backward walk reversed, then the start, then the forward walk. */
+  for (i = backward->len; i > 0; i--)
+    g_array_append_val (chain->points, g_array_index (backward, EdgeChainPoint, i - 1));
+  g_array_append_val (chain->points, start);
+
+  walk (mask, width, height, x, y, chain->points);
+
+  g_array_free (backward, TRUE);
+
+  for (i = 1; i < chain->points->len; i++)
+    {
+      EdgeChainPoint *a = &g_array_index (chain->points, EdgeChainPoint, i - 1);
+      EdgeChainPoint *b = &g_array_index (chain->points, EdgeChainPoint, i);
+
+      chain->length += (a->x != b->x && a->y != b->y) ? G_SQRT2 : 1.0;
+    }
+
+  return chain;
+}
+
+static void
+edge_chain_free (gpointer data)
+{
+  EdgeChain *chain = data;
+
+  g_array_free (chain->points, TRUE);
+  g_free (chain);
+}
+
+/*
+Keep chain if long enough, else free it.
+Points are converted from mask coordinates to image coordinates.
+*/
+static void
+keep_chain (
+  GPtrArray           *chains,
+  EdgeChain           *chain,
+  const GeglRectangle *rect,
+  gdouble              min_length)
+{
+  guint i;
+
+  if (chain->length < min_length)
+    {
+      edge_chain_free (chain);
+      return;
+    }
+
+  for (i = 0; i < chain->points->len; i++)
+    {
+      EdgeChainPoint *point = &g_array_index (chain->points, EdgeChainPoint, i);
+
+      point->x += rect->x;
+      point->y += rect->y;
+    }
+
+  g_ptr_array_add (chains, chain);
+}
+
+/* Convert the magnitude channel of src, over rect, into the mask. */
+static void
+read_mask (
+  GeglBuffer          *src,
+  const GeglRectangle *rect,
+  const Babl          *format,
+  guint8              *mask)
+{
+  GeglBufferIterator *iter = gegl_buffer_iterator_new (src, rect, 0, format,
+                                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      const gfloat *in  = iter->items[0].data;
+      GeglRectangle roi = iter->items[0].roi;
+      gint          row, col;
+
+      for (row = 0; row < roi.height; row++)
+        {
+          guint8 *mask_row = mask
+                             + (roi.y - rect->y + row) * rect->width
+                             + (roi.x - rect->x);
+
+          for (col = 0; col < roi.width; col++)
+            mask_row[col] = is_edge_magnitude (in[(row * roi.width + col) * FPP]) ? MASK_EDGE : 0;
+        }
+    }
+}
+
+
+/*
+Trace the edges of src, over src_rect, into chains.
+
+Src is format Y'A float, typically the output of canny:
+white edges on black.
+
+Chains are 8-connected.
+Chains start first at end points (pixels having one edge neighbor),
+so open curves become one chain, end to end.
+Then chains start at any edge pixel not yet in a chain:
+branches at junctions, and closed curves.
+
+Every edge pixel is in exactly one chain,
+and tracing visits each edge pixel a bounded number of times,
+so the cost is linear in the count of edge pixels
+(plus a scan of the rect to find them.)
+
+Reports to progress per row of the scans, and stops early when it is cancelled,
+returning the chains traced so far.
+Progress can be NULL.
+
+Returns an array of EdgeChain, of length at least min_length.
+*/
+GPtrArray *
+edge_chains_trace
+ (GeglBuffer          *src,
+  const GeglRectangle *src_rect,
+  const Babl          *format,
+  gdouble              min_length,
+  OpProgress          *progress)
+{
+  GPtrArray *chains = g_ptr_array_new_with_free_func (edge_chain_free);
+  guint8    *mask;
+  gint       x, y;
+
+  g_debug ("%s", G_STRFUNC);
+
+  if (src_rect->width <= 0 || src_rect->height <= 0)
+    return chains; // Nothing to process.
+
+  mask = g_new (guint8, (gsize) src_rect->width * src_rect->height);
+  read_mask (src, src_rect, format, mask);
+
+  /* Chains from end points. */
+  for (y = 0; y < src_rect->height && ! op_progress_is_cancelled (progress); y++)
+    {
+      op_progress_report (progress, 0.5 * y / src_rect->height, "Tracing edges from end points");
+
+      for (x = 0; x < src_rect->width; x++)
+        if (mask[y * src_rect->width + x] == MASK_EDGE &&
+            count_edge_neighbors (mask, src_rect->width, src_rect->height, x, y) == 1)
+          keep_chain (chains,
+                      trace_chain (mask, src_rect->width, src_rect->height, x, y),
+                      src_rect, min_length);
+    }
+
+  /* Chains from what remains: branches and closed curves. */
+  for (y = 0; y < src_rect->height && ! op_progress_is_cancelled (progress); y++)
+    {
+      op_progress_report (progress, 0.5 + 0.5 * y / src_rect->height, "Tracing remaining edges");
+
+      for (x = 0; x < src_rect->width; x++)
+        if (mask[y * src_rect->width + x] == MASK_EDGE)
+          keep_chain (chains,
+                      trace_chain (mask, src_rect->width, src_rect->height, x, y),
+                      src_rect, min_length);
+    }
+
+  g_free (mask);
+
+  g_debug ("%s traced %u chains", G_STRFUNC, chains->len);
+
+  return chains;
+}
+
+/*
+Write chains to a file at path, as JSON:
+
+{ "x": 0, "y": 0, "width": 640, "height": 480,
+  "chains": [ { "length": 12.243, "points": [ [x, y], ... ] }, ... ] }
+
+Points are in image coordinates.
+*/
+gboolean
+edge_chains_write_json
+ (GPtrArray           *chains,
+  const GeglRectangle *rect,
+  const gchar         *path,
+  GError             **error)
+{
+  GString *json = g_string_new (NULL);
+  gboolean result;
+  guint    i, j;
+
+  g_string_append_printf (json,
+                          "{ \"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d,\n"
+                          "  \"chains\": [",
+                          rect->x, rect->y, rect->width, rect->height);
+
+  for (i = 0; i < chains->len; i++)
+    {
+      EdgeChain *chain = g_ptr_array_index (chains, i);
+      gchar      length[G_ASCII_DTOSTR_BUF_SIZE];
+
+      // Not locale dependent, JSON requires a period for the decimal point.
+      g_ascii_formatd (length, sizeof (length), "%.3f", chain->length);
+
+      g_string_append_printf (json, "%s\n    { \"length\": %s, \"points\": [",
+                              i > 0 ? "," : "", length);
+
+      for (j = 0; j < chain->points->len; j++)
+        {
+          EdgeChainPoint *point = &g_array_index (chain->points, EdgeChainPoint, j);
+
+          g_string_append_printf (json, "%s[%d, %d]", j > 0 ? ", " : "", point->x, point->y);
+        }
+
+      g_string_append (json, "] }");
+    }
+
+  g_string_append (json, "\n  ] }\n");
+
+  result = g_file_set_contents (path, json->str, json->len, error);
+
+  g_string_free (json, TRUE);
+
+  return result;
+}
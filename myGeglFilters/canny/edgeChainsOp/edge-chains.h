@@ -0,0 +1,29 @@
+
+
+/* A chain of edge pixels, an ordered polyline. */
+typedef struct
+{
+  GArray  *points;  // of EdgeChainPoint, in order along the chain
+  gdouble  length;  // in pixels, sum of distances between successive points
+} EdgeChain;
+
+typedef struct
+{
+  gint x, y;
+} EdgeChainPoint;
+
+
+GPtrArray *
+edge_chains_trace
+ (GeglBuffer          *src,
+  const GeglRectangle *src_rect,
+  const Babl          *format,
+  gdouble              min_length,
+  OpProgress          *progress);
+
+gboolean
+edge_chains_write_json
+ (GPtrArray           *chains,
+  const GeglRectangle *rect,
+  const gchar         *path,
+  GError             **error);
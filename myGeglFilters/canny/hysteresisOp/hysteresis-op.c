@@ -34,6 +34,59 @@ promoting non-white pixels to black where connected to black pixels.
 
 #ifdef GEGL_PROPERTIES
 
+property_int (strip_height, "Strip height", 0)
+  description ("Rows per strip, streaming strips for images too large for memory. "
+               "Zero processes the whole image in memory.")
+  value_range (0, 65536)
+  ui_range    (0, 4096)
+
+property_boolean (remove_weak, "Remove weak", FALSE)
+  description ("Output binary: white edges, weak pixels not promoted to black. "
+               "Else weak pixels keep their value.")
+
+property_boolean (half, "Half floats", FALSE)
+  description ("The input is IEEE half floats, as from double threshold when half.")
+
+property_int (max_passes, "Max passes", 0)
+  description ("Zero: brushfire until no pixel is promoted, over the whole image, exact. "
+               "Else at most this many passes, over only the region asked for: "
+               "local and fast, for previews, but weak pixels far along a chain stay weak.")
+  value_range (0, 1000)
+  ui_range    (0, 16)
+
+/*
+Statistics, read back after processing.
+Set by process, not by a user, like the extent properties of gegl:text.
+Written directly to the fields, not by g_object_set,
+so setting them does not notify, nor invalidate the op.
+Reading them is reading a field, no cost when nobody reads.
+Not written by a cancelled render: they stay those of the last complete one.
+
+Counts are doubles since an int is too small for gigapixel counts.
+*/
+property_int    (passes, "Passes", 0)
+  description   ("Read only, after processing: passes over the image")
+  ui_meta       ("role", "output-extent")
+
+property_double (promotions, "Promotions", 0.0)
+  description   ("Read only, after processing: weak pixels promoted to strong")
+  ui_meta       ("role", "output-extent")
+
+property_double (strong_count, "Strong pixels", 0.0)
+  description   ("Read only, after processing: pixels white, or promoted")
+  ui_meta       ("role", "output-extent")
+
+property_double (weak_count, "Weak pixels", 0.0)
+  description   ("Read only, after processing: weak pixels not promoted")
+  ui_meta       ("role", "output-extent")
+
+property_double (none_count, "None pixels", 0.0)
+  description   ("Read only, after processing: black pixels")
+  ui_meta       ("role", "output-extent")
+
+property_double (time_ms, "Time", 0.0)
+  description   ("Read only, after processing: milliseconds in hysteresis")
+  ui_meta       ("role", "output-extent")
 
 #else
 
@@ -48,6 +101,10 @@ promoting non-white pixels to black where connected to black pixels.
 // Base on the above definitions, gegl-op.h generates code for the operation
 #include "gegl-op.h"
 
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-progress.h"
+#include "op-trace.h"
 #include "hysteresis.h"
 
 
@@ -62,13 +119,74 @@ static void prepare (GeglOperation *operation)
   // GeglOperationAreaFilter *area = GEGL_OPERATION_AREA_FILTER (operation);
   // area->left = area->right = area->top = area->bottom = 1;
 
-  // Set the input and output formats to Y'A float with the specified space.
+  // The input is the gradient format of double threshold, no conversion between them.
+  // The output is Y'A float with the specified space, to view, the final result of canny.
   // Y' is the magnitude channel, A is the direction channel.
-  gegl_operation_set_format (operation, "input",  babl_format_with_space ("Y'A float", space));
+  // It is written as float[2], converted by the buffer iterator, in one pass.
+  // When half, the input is half[2], read as float[2], converted by the iterator too,
+  // as hysteresis reads it into its plane of states, and again as it writes back.
+  gegl_operation_set_format (operation, "input",
+                             GEGL_PROPERTIES (operation)->half ? bootchk_gradient_half_format ()
+                                                               : bootchk_gradient_format ());
   gegl_operation_set_format (operation, "output", babl_format_with_space ("Y'A float", space));
 }
 
 
+/*
+Hysteresis is not local: a weak pixel can be promoted
+by a strong pixel anywhere along a connected path.
+So require, and compute, the whole input at once.
+
+Unless the passes are bounded: then it is made local, the roi alone,
+so a preview computes only the view, not the whole image upstream.
+Chains leaving the roi are cut, one more approximation of the bound.
+*/
+static GeglRectangle
+get_required_for_output (GeglOperation       *operation,
+                         const gchar         *input_pad,
+                         const GeglRectangle *roi)
+{
+  GeglRectangle *in_rect = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (GEGL_PROPERTIES (operation)->max_passes > 0)
+    return *roi;
+
+  /* Don't request an infinite plane */
+  if (in_rect == NULL || gegl_rectangle_is_infinite_plane (in_rect))
+    return *roi;
+
+  return *in_rect;
+}
+
+static GeglRectangle
+get_cached_region (GeglOperation       *operation,
+                   const GeglRectangle *roi)
+{
+  return get_required_for_output (operation, "input", roi);
+}
+
+/*
+For the same reason, a change of the input anywhere can change the output anywhere:
+invalidate it all, so a cached result is not kept stale outside the change.
+Upstream, only the changed region is invalidated, and recomputed from GEGL's caches,
+e.g. between the frames of a sequence, see tools/sequence.h.
+Local when the passes are bounded.
+*/
+static GeglRectangle
+get_invalidated_by_change (GeglOperation       *operation,
+                           const gchar         *input_pad,
+                           const GeglRectangle *input_region)
+{
+  GeglRectangle *in_rect = gegl_operation_source_get_bounding_box (operation, "input");
+
+  if (GEGL_PROPERTIES (operation)->max_passes > 0 ||
+      in_rect == NULL || gegl_rectangle_is_infinite_plane (in_rect))
+    return *input_region;
+
+  return *in_rect;
+}
+
+
 /* Has type of FilterClass.Process */
 static gboolean
 process (GeglOperation       *operation,
@@ -88,17 +206,52 @@ process (GeglOperation       *operation,
 
   GeglRectangle compute = gegl_operation_get_required_for_output (operation, "input", result);
   */
-  
+  GeglProperties *o = GEGL_PROPERTIES (operation);
+  OpProgress      progress;
+  OpTrace         trace;
+  HysteresisStats stats;
+  gboolean        completed;
+  gint64          start = g_get_monotonic_time ();
+
+  op_trace_begin (&trace, operation, rect);
+
+  /* Hysteresis of a large image can take many passes, report them, and stop when stale. */
+  op_progress_begin (&progress, operation, rect);
+
   hysteresis (
     input,
     /* Using same rect for input and output. */
     rect, 
     output, 
     rect,
-    /* Using same format */
-    gegl_operation_get_format (operation, "output"));
-
-  return TRUE;
+    /* Using the gradient format of floats, for src and dst */
+    bootchk_gradient_format (),
+    o->strip_height,
+    o->max_passes,
+    o->remove_weak,
+    &progress,
+    &stats);
+
+  completed = op_progress_end (&progress);
+  op_trace_bytes (&trace, stats.allocated);
+  op_trace_end (&trace);
+
+  // The counts of a cancelled render are partial: keep those of the last complete one.
+  if (completed)
+    {
+      o->passes       = stats.passes;
+      o->promotions   = stats.promotions;
+      o->strong_count = stats.strong;
+      o->weak_count   = stats.weak;
+      o->none_count   = stats.none;
+      o->time_ms      = (g_get_monotonic_time () - start) / 1000.0;
+
+      g_debug ("%s: %d passes, %.0f promotions, %.1f ms",
+               G_STRFUNC, o->passes, o->promotions, o->time_ms);
+    }
+
+  // Partial when cancelled, not the result, see op-progress.h.
+  return completed;
 }
 
 static void
@@ -116,8 +269,11 @@ gegl_op_class_init (GeglOpClass *klass)
   
   
   // Override superclass methods.
-  operation_class->prepare = prepare;
-  filter_class->process    = process;
+  operation_class->prepare                   = prepare;
+  operation_class->get_required_for_output   = get_required_for_output;
+  operation_class->get_cached_region         = get_cached_region;
+  operation_class->get_invalidated_by_change = get_invalidated_by_change;
+  filter_class->process                      = process;
 
   // Set the abyss policy for this operation.
   // operation_class->get_abyss_policy = gegl_operation_area_filter_get_abyss_policy;
@@ -126,6 +282,9 @@ gegl_op_class_init (GeglOpClass *klass)
   operation_class->opencl_support = FALSE;
   operation_class->threaded       = FALSE;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
     "title",       "Promote White Connected Pixels",
     "name",        "bootchk:hysteresis",
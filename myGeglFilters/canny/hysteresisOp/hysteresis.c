@@ -1,183 +1,643 @@
-
 #include <gegl.h>
 
+#include "bootchk-kernels.h"
+#include "op-progress.h"
 #include "hysteresis.h"
 
 
 
 
-#define FPP 2 // Floats per pixel for the input format (Y'A float has 2 channels)
-
-/* Does pixel have magnitude with criteria "strong" */
-#define is_strong_neighbor(pixel) \
-  ((pixel[0] > 0.5))
+#define FPP 2 // Floats per pixel for the format (float[2] and Y'A float have 2 channels)
 
 /*
-Check if center is connected to strong edges/neighbors.
-8-connected neighborhood (alternative is 4 or 6 connected).
-Returns TRUE if any neighbor is strong.
+The working state of a pixel is one byte per pixel,
+see BOOTCHK_HYST_WEAK and BOOTCHK_HYST_STRONG in the kernels library.
+
+Compared to a float copy of the input (8 bytes per pixel)
+the working set is 8x smaller.
 */
-static gboolean
-is_connected_to_strong(
-  gfloat *top_left,    gfloat *top,    gfloat *top_right,
-  gfloat *left,        gfloat *center, gfloat *right,
-  gfloat *bottom_left, gfloat *bottom, gfloat *bottom_right
-)
-{
-  // assert center is weak, we don't check it here.
-  gboolean result = 
-    is_strong_neighbor(top_left) ||
-    is_strong_neighbor(top) ||
-    is_strong_neighbor(top_right) ||
-    is_strong_neighbor(left) ||
-    // not check is_strong_neighbor(center) ||
-    is_strong_neighbor(right) ||
-    is_strong_neighbor(bottom_left) ||
-    is_strong_neighbor(bottom) ||
-    is_strong_neighbor(bottom_right);
-
-  return result;
-}
+
 
 /*
 A brushfire operation.
-Raster scan the destination rectangle.
 Promotes weak pixels to strong pixels
 if they are connected to strong neighbors.
 The fire is strongness burning through connected weak pixels.
+One pass is bootchk_hyst_brushfire, in the kernels library.
 
-Mutates the src buffer.
+Mutates the state plane.
 Was initialized from the input buffer,
 but since mutated repeatedly.
 
-Returns whether fire advanced,
-i.e. some pixel was promoted from weak to strong.
+Burns only within bounds, of a plane of width.
+
+Returns the count of pixels promoted from weak to strong,
+zero when the fire is out.
 */
-static gboolean
+static gsize
 brushfire (
-  gfloat              *src_buf,
-  const GeglRectangle *src_rect
+  guint8              *states,
+  const GeglRectangle *bounds,
+  gint                 width
 )
 {
-  guint col, row;
-  // Used to clamp pointers to neighbors.
-  gfloat *past_src_buf = src_buf + src_rect->width * src_rect->height * FPP;
-  gboolean promoted = FALSE;
-  guint promoted_count = 0;
+  gsize promoted_count = bootchk_hyst_brushfire (states + (gsize) bounds->y * width + bounds->x,
+                                                 bounds->width, bounds->height, width);
+
+  g_debug ("%s: promoted %" G_GSIZE_FORMAT " pixels", G_STRFUNC, promoted_count);
+
+  return promoted_count;
+}
+
+
+/*
+The bounds, in the plane of states of width x height, of the pixels not black,
+grown by one pixel (within the plane) so the pixels inside have all their neighbors:
+the brushfire clamps neighbors into its rect, which must not change what it burns.
+Empty when the plane is all black.
+
+Outside, the brushfire has nothing to burn, e.g. the transparent margins of a cut-out.
+One scan of a byte per pixel, and each pass then scans only the bounds.
+*/
+static GeglRectangle
+states_bounds (
+  const guint8 *states,
+  gint          width,
+  gint          height
+)
+{
+  GeglRectangle bounds = { 0, 0, 0, 0 };
+  gint          left   = width;
+  gint          right  = -1;
+  gint          top    = height;
+  gint          bottom = -1;
+  gint          row, col;
+
+  for (row = 0; row < height; row++)
+    {
+      const guint8 *row_states = states + (gsize) row * width;
+
+      for (col = 0; col < width && row_states[col] == 0; col++)
+        ;
+
+      if (col == width)
+        continue;  // All black.
+
+      left   = MIN (left, col);
+      top    = MIN (top, row);
+      bottom = row;
+
+      for (col = width - 1; row_states[col] == 0; col--)
+        ;
+      right = MAX (right, col);
+    }
+
+  if (bottom < 0)
+    return bounds;
+
+  left   = MAX (left - 1, 0);
+  top    = MAX (top - 1, 0);
+  right  = MIN (right + 1, width - 1);
+  bottom = MIN (bottom + 1, height - 1);
+
+  gegl_rectangle_set (&bounds, left, top, right - left + 1, bottom - top + 1);
+
+  return bounds;
+}
+
+
+/*
+Convert the magnitude channel of src, over rect, into the state plane.
+The plane has the same dimensions as rect.
+Reads tile memory directly, chunk by chunk.
+*/
+static void
+read_state_plane (
+  GeglBuffer          *src,
+  const GeglRectangle *rect,
+  const Babl          *format,
+  guint8              *states)
+{
+  GeglBufferIterator *iter = gegl_buffer_iterator_new (src, rect, 0, format,
+                                                       GEGL_ACCESS_READ, GEGL_ABYSS_NONE, 1);
 
-  for (row = 0; row < src_rect->height; row++)
+  while (gegl_buffer_iterator_next (iter))
     {
-      gfloat *row_start = src_buf + row * src_rect->width * FPP;
-      gfloat *row_next  = row_start + src_rect->width * FPP;
+      const gfloat *in  = iter->items[0].data;
+      GeglRectangle roi = iter->items[0].roi;
+      gint          row;
+
+      for (row = 0; row < roi.height; row++)
+        bootchk_hyst_states_of_row (in + row * roi.width * FPP, FPP,
+                                    states
+                                    + (roi.y - rect->y + row) * rect->width
+                                    + (roi.x - rect->x),
+                                    roi.width);
+    }
+}
+
+/*
+Write dst over dst_rect.
+The magnitude channel: white where the state plane says promoted,
+else the magnitude from src.
+The direction channel copied from src.
+Reads and writes tile memory directly, chunk by chunk.
+Counts the final states into counts.
+When remove_weak, binary: white where strong, else black.
+*/
+static void
+write_state_plane (
+  GeglBuffer          *src,
+  const GeglRectangle *src_rect,
+  GeglBuffer          *dst,
+  const GeglRectangle *dst_rect,
+  const Babl          *format,
+  const guint8        *states,
+  gboolean             remove_weak,
+  BootchkHystCounts   *counts)
+{
+  GeglBufferIterator *iter = gegl_buffer_iterator_new (dst, dst_rect, 0, format,
+                                                       GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 2);
+
+  gegl_buffer_iterator_add (iter, src, src_rect, 0, format,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
 
-      for (col = 0; col < src_rect->width; col++)
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gfloat       *out = iter->items[0].data;
+      const gfloat *in  = iter->items[1].data;
+      GeglRectangle roi = iter->items[0].roi;
+      gint          row;
+
+      for (row = 0; row < roi.height; row++)
+        bootchk_hyst_write_row (in + row * roi.width * FPP,
+                                states
+                                + (roi.y - dst_rect->y + row) * dst_rect->width
+                                + (roi.x - dst_rect->x),
+                                out + row * roi.width * FPP,
+                                roi.width,
+                                remove_weak,
+                                counts);
+    }
+}
+
+
+/*
+Union-find over connected components of candidate pixels
+(pixels that are weak or strong, i.e. not black.)
+
+Components are labeled while streaming strips, so a component
+can span strips, and is only known complete after the last strip.
+
+A weak pixel is promoted when a chain of weak pixels leads to it
+from a strong pixel, the same chain the brushfire burns along:
+- a weak pixel, not itself strong, when its component has a strong pixel.
+- a weak pixel that is also strong (magnitude above 0.5) when its component
+  has any other pixel: that neighbor is strong and burns it,
+  or is weak and burns it back after being burned by it.
+So for each component keep two flags.
+
+Label 0 is "no component", for black pixels.
+*/
+#define COMPONENT_HAS_STRONG 0x01
+#define COMPONENT_HAS_MANY   0x02  // more than one pixel
+
+typedef struct
+{
+  GArray *parent;  // of guint32, indexed by label
+  GArray *flags;   // of guint8, indexed by label, valid for roots
+} Components;
+
+static guint32
+components_new_label (Components *components, guint8 flags)
+{
+  guint32 label = components->parent->len;
+
+  g_array_append_val (components->parent, label);
+  g_array_append_val (components->flags, flags);
+
+  return label;
+}
+
+static guint32
+components_find (Components *components, guint32 label)
+{
+  guint32 *parent = (guint32 *) (void *) components->parent->data;
+
+  // Path halving.
+  while (parent[label] != label)
+    {
+      parent[label] = parent[parent[label]];
+      label = parent[label];
+    }
+
+  return label;
+}
+
+static guint32
+components_union (Components *components, guint32 a, guint32 b)
+{
+  guint32 *parent = (guint32 *) (void *) components->parent->data;
+  guint8  *flags  = (guint8 *)  (void *) components->flags->data;
+
+  a = components_find (components, a);
+  b = components_find (components, b);
+
+  if (a == b)
+    return a;
+
+  // Older label is root, keeps labels near the top of a chain short.
+  if (b < a)
+    {
+      guint32 swap = a;
+
+      a = b;
+      b = swap;
+    }
+
+  parent[b] = a;
+  flags[a] |= flags[b] | COMPONENT_HAS_MANY;
+
+  return a;
+}
+
+/*
+Label the candidate pixels of a strip of states.
+Labels go to labels, one per pixel of the strip.
+
+8-connected: a pixel joins the components of its left neighbor
+and of its three neighbors in the row above.
+For the first row of the strip, the row above is above_labels:
+the last row of the previous strip, or NULL for the first strip.
+*/
+static void
+label_strip (
+  Components    *components,
+  const guint8  *states,
+  guint32       *labels,
+  const guint32 *above_labels,
+  gint           width,
+  gint           height)
+{
+  gint row, col;
+
+  for (row = 0; row < height; row++)
+    {
+      const guint8  *row_states = states + row * width;
+      guint32       *row_labels = labels + row * width;
+      const guint32 *above      = row > 0 ? row_labels - width : above_labels;
+
+      for (col = 0; col < width; col++)
         {
-          /* Pointers to neighbors. */
-          gfloat *top_left,    *top,     *top_right;
-          gfloat *left,        *center,  *right;
-          gfloat *bottom_left, *bottom,  *bottom_right;
-
-          center  = row_start + col * FPP;
-
-          /*
-          Promoting center weak to strong, scanning for weak pixels.
-          Alternate design would scan for strong pixels, 
-          and promote neighbors weak to strong.
-          But this is might be more efficient.
-          We anticipate edges are thin, with few neighbors to promote.
-          */
-          if (center[0] == 1.0 ||  // Strong, skip. (represents white, edge detected)
-              center[0] <= 0.0     // Zero, skip. (represents black, no edge detected)
-              )
+          guint8  state = row_states[col];
+          guint32 label = 0;
+          gint    i;
+
+          if (state == 0)
             {
-              // Not weak, skip.
+              row_labels[col] = 0;  // Black, no component.
               continue;
             }
 
-          /* 
-          Compute pointers to neighbor pixels.
-          Using address arithmetic.
-          Clamping pointers into the buf.
-          */
-
-          /* Unclamped pointers to neighbor pixels. */
-          left         = center - FPP;
-          right        = center + FPP;
-
-          top          = center - src_rect->width * FPP;
-          top_left     = top - FPP;
-          top_right    = top + FPP;
-          
-          bottom       = center + src_rect->width * FPP;
-          bottom_left  = bottom - FPP;
-          bottom_right = bottom + FPP;
-
-          /* 
-          When pointers to neighbors are out of source rect bounds,
-          clamp them into the rect.
-          */
-          if (top < src_buf)
-            {
-              top_left  += src_rect->width * FPP;
-              top       += src_rect->width * FPP;
-              top_right += src_rect->width * FPP;
-            }
-          else if (bottom >= past_src_buf)
-            {
-              bottom_left  -= src_rect->width * FPP;
-              bottom       -= src_rect->width * FPP;
-              bottom_right -= src_rect->width * FPP;
-            }
+          if (col > 0 && row_labels[col - 1] != 0)
+            label = row_labels[col - 1];
+
+          if (above != NULL)
+            for (i = MAX (col - 1, 0); i <= MIN (col + 1, width - 1); i++)
+              if (above[i] != 0)
+                label = label ? components_union (components, label, above[i]) : above[i];
+
+          if (label == 0)
+            label = components_new_label (components,
+                                          (state & BOOTCHK_HYST_STRONG) ? COMPONENT_HAS_STRONG : 0);
+          else
+            g_array_index (components->flags, guint8, components_find (components, label)) |=
+              COMPONENT_HAS_MANY | ((state & BOOTCHK_HYST_STRONG) ? COMPONENT_HAS_STRONG : 0);
 
-          if (left < row_start)
+          row_labels[col] = label;
+        }
+    }
+}
+
+/*
+Label a strip again, after label_strip labeled every strip,
+without storing the labels of the whole image between the passes.
+
+A new label is made exactly where label_strip made one:
+where the pixel is a candidate and its left and above neighbors are not.
+So counting new labels from next_label, in the same order of strips,
+gives every pixel the label label_strip gave it, or a label of the same component.
+No unions: the components are already complete.
+*/
+static void
+relabel_strip (
+  const guint8  *states,
+  guint32       *labels,
+  const guint32 *above_labels,
+  gint           width,
+  gint           height,
+  guint32       *next_label)
+{
+  gint row, col;
+
+  for (row = 0; row < height; row++)
+    {
+      const guint8  *row_states = states + row * width;
+      guint32       *row_labels = labels + row * width;
+      const guint32 *above      = row > 0 ? row_labels - width : above_labels;
+
+      for (col = 0; col < width; col++)
+        {
+          guint32 label = 0;
+          gint    i;
+
+          if (row_states[col] == 0)
             {
-              top_left    += FPP;
-              left        += FPP;
-              bottom_left += FPP;
+              row_labels[col] = 0;
+              continue;
             }
-          else if (right >= row_next)
+
+          if (col > 0)
+            label = row_labels[col - 1];
+
+          if (label == 0 && above != NULL)
+            for (i = MAX (col - 1, 0); i <= MIN (col + 1, width - 1) && label == 0; i++)
+              label = above[i];
+
+          row_labels[col] = label ? label : (*next_label)++;
+        }
+    }
+}
+
+/*
+Replace the union-find by the flags of each label's component,
+one byte per label, and free the parents.
+A root is older than the labels below it, so ascending order
+reads roots' flags before any label overwrites its own.
+*/
+static guint8 *
+components_resolve (Components *components)
+{
+  guint8 *flags = (guint8 *) (void *) components->flags->data;
+  guint32 label;
+
+  for (label = 1; label < components->parent->len; label++)
+    flags[label] = flags[components_find (components, label)];
+
+  g_array_free (components->parent, TRUE);
+  components->parent = NULL;
+
+  return flags;
+}
+
+/*
+Does the pixel in state, in the component with label, get promoted.
+component_flags are resolved, indexed by any label of the component.
+
+On the edges of the rect the brushfire clamps neighbors into the rect,
+so a pixel there is its own neighbor, and burns itself when strong.
+*/
+static inline gboolean
+is_promoted_in_component (
+  const guint8 *component_flags,
+  guint8        state,
+  guint32       label,
+  gboolean      is_on_edge)
+{
+  guint8 flags;
+
+  if (! (state & BOOTCHK_HYST_WEAK))
+    return FALSE;
+
+  if (is_on_edge && (state & BOOTCHK_HYST_STRONG))
+    return TRUE;
+
+  flags = component_flags[label];
+
+  if (state & BOOTCHK_HYST_STRONG)
+    return (flags & COMPONENT_HAS_MANY) != 0;
+  else
+    return (flags & COMPONENT_HAS_STRONG) != 0;
+}
+
+/*
+Write a strip of dst, promoting by component.
+Like write_state_plane, but the plane is the strip, and states are recomputed from src.
+Adds to the counts of stats.
+*/
+static void
+write_strip (
+  const guint8        *component_flags,
+  GeglBuffer          *src,
+  GeglBuffer          *dst,
+  const GeglRectangle *rect,
+  const GeglRectangle *strip_rect,
+  const Babl          *format,
+  const guint32       *labels,
+  gboolean             remove_weak,
+  HysteresisStats     *stats)
+{
+  GeglBufferIterator *iter = gegl_buffer_iterator_new (dst, strip_rect, 0, format,
+                                                       GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 2);
+
+  gegl_buffer_iterator_add (iter, src, strip_rect, 0, format,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
+    {
+      gfloat       *out = iter->items[0].data;
+      const gfloat *in  = iter->items[1].data;
+      GeglRectangle roi = iter->items[0].roi;
+      gint          row, col;
+
+      for (row = 0; row < roi.height; row++)
+        {
+          gint           y          = roi.y + row;
+          const guint32 *row_labels = labels
+                                      + (y - strip_rect->y) * strip_rect->width
+                                      + (roi.x - strip_rect->x);
+
+          for (col = 0; col < roi.width; col++)
             {
-              top_right    -= FPP;
-              right        -= FPP;
-              bottom_right -= FPP;
+              gint     x          = roi.x + col;
+              gint     index      = (row * roi.width + col) * FPP;
+              gfloat   magnitude  = in[index];
+              guint8   state      = bootchk_hyst_state_of_magnitude (magnitude);
+              gboolean is_on_edge = (x == rect->x || x == rect->x + rect->width - 1 ||
+                                     y == rect->y || y == rect->y + rect->height - 1);
+
+              if (is_promoted_in_component (component_flags, state, row_labels[col], is_on_edge))
+                {
+                  out[index] = 1.0;
+                  stats->promotions++;
+                  stats->strong++;
+                }
+              else if (state == 0)
+                {
+                  out[index] = remove_weak ? 0.0 : magnitude;
+                  stats->none++;
+                }
+              else if (state & BOOTCHK_HYST_WEAK)
+                {
+                  out[index] = remove_weak ? 0.0 : magnitude;
+                  stats->weak++;
+                }
+              else
+                {
+                  out[index] = remove_weak ? 1.0 : magnitude;
+                  stats->strong++;
+                }
+
+              out[index + 1] = in[index + 1];
             }
+        }
+    }
+}
 
-          /*
-          
-          */
-          if (is_connected_to_strong(
-                top_left, top, top_right,
-                left, center, right,
-                bottom_left, bottom, bottom_right))
-            {
-              // Promote to strong. Magnitude becomes max, viewed as white.
-              center[0] = 1.0;
-              promoted_count++;
-              promoted = TRUE; // Fire advanced, a pixel was promoted.
-            } 
-          // else remains zero or weak. 
+/*
+Hysteresis streaming horizontal strips of strip_height rows,
+for images too large for a state plane in memory.
+Same result as the brushfire, computed by connected components.
+
+First pass: label the components of each strip,
+carrying labels from the last row of one strip into the next.
+Only the labels of the strip and of the row above it are kept.
+Then resolve the union-find to one byte of flags per label.
+Second pass: each strip again, relabeled in the same order, see relabel_strip,
+promoting weak pixels of components having strong pixels.
+
+Peak memory is the states and labels of one strip, and one row of labels,
+plus the union-find, proportional to the count of components, not pixels:
+five bytes per component while labeling, one byte while writing.
+*/
+static void
+hysteresis_strips
+ (GeglBuffer          *src,
+  const GeglRectangle *rect,
+  GeglBuffer          *dst,
+  const Babl          *format,
+  gint                 strip_height,
+  gboolean             remove_weak,
+  OpProgress          *progress,
+  HysteresisStats     *stats)
+{
+  Components    components;
+  guint8       *component_flags;
+  guint32       next_label   = 1;
+  guint8       *states       = g_new (guint8, (gsize) rect->width * strip_height);
+  guint32      *labels       = g_new (guint32, (gsize) rect->width * strip_height);
+  guint32      *above_labels = g_new (guint32, rect->width);
+  gsize         n_labels;
+  GeglRectangle strip_rect;
+  gint          y;
+  gdouble       rows = 2.0 * rect->height;  // rows of both passes, for progress
+
+  components.parent       = g_array_new (FALSE, FALSE, sizeof (guint32));
+  components.flags        = g_array_new (FALSE, FALSE, sizeof (guint8));
+  components_new_label (&components, 0);  // Label 0, no component.
+
+  for (y = rect->y; y < rect->y + rect->height; y += strip_height)
+    {
+      if (op_progress_is_cancelled (progress))
+        goto cancelled;
 
-          // g_debug ("dst_buf[%d] = %f", dest_index, dst_buf[dest_index]);
-        } // End of inner loop over col
-    } // End of outer loop over row
+      op_progress_report (progress, (y - rect->y) / rows, "Hysteresis labeling strips");
 
-  g_debug ("%s: promoted %d pixels", G_STRFUNC, promoted_count);
+      gegl_rectangle_set (&strip_rect, rect->x, y,
+                          rect->width, MIN (strip_height, rect->y + rect->height - y));
 
-  // Return whether any pixel was promoted.
-  return promoted;
-} // End of brushfire function
+      read_state_plane (src, &strip_rect, format, states);
+      label_strip (&components, states, labels,
+                   y > rect->y ? above_labels : NULL,
+                   strip_rect.width, strip_rect.height);
+
+      memcpy (above_labels,
+              labels + (strip_rect.height - 1) * strip_rect.width,
+              strip_rect.width * sizeof (guint32));
+    }
+
+  g_debug ("%s labeled %u components", G_STRFUNC, components.parent->len - 1);
+  stats->passes++;
+
+  n_labels        = components.parent->len;
+  component_flags = components_resolve (&components);
+
+  for (y = rect->y; y < rect->y + rect->height; y += strip_height)
+    {
+      if (op_progress_is_cancelled (progress))
+        goto cancelled;
+
+      op_progress_report (progress, (rect->height + y - rect->y) / rows, "Hysteresis writing strips");
+
+      gegl_rectangle_set (&strip_rect, rect->x, y,
+                          rect->width, MIN (strip_height, rect->y + rect->height - y));
+
+      read_state_plane (src, &strip_rect, format, states);
+      relabel_strip (states, labels,
+                     y > rect->y ? above_labels : NULL,
+                     strip_rect.width, strip_rect.height, &next_label);
+      write_strip (component_flags, src, dst, rect, &strip_rect, format, labels,
+                   remove_weak, stats);
+
+      memcpy (above_labels,
+              labels + (strip_rect.height - 1) * strip_rect.width,
+              strip_rect.width * sizeof (guint32));
+    }
+
+  // Relabeling made as many labels as labeling, else src changed between the passes.
+  g_warn_if_fail (next_label == n_labels);
+  stats->passes++;
+
+cancelled:
+  // The union-find at its largest, before resolving.
+  stats->allocated = (gsize) rect->width * strip_height * (sizeof (guint8) + sizeof (guint32))
+                     + rect->width * sizeof (guint32)
+                     + components.flags->len * (sizeof (guint32) + sizeof (guint8));
+
+  if (components.parent != NULL)
+    g_array_free (components.parent, TRUE);
+  g_array_free (components.flags, TRUE);
+  g_free (states);
+  g_free (labels);
+  g_free (above_labels);
+}
 
 
 /*
-Src and dst are format YA.
-Interpreted as a gradient field: an array of vectors.  
+Src and dst are read and written in format, of two channels, float[2] or Y'A float.
+Interpreted as a gradient field: an array of vectors.
 A vector has two components, magnitude and direction.
 
 Requires the source and destination rectangles to be the same size.
-The strategy here is to clamp pointers to neighbors back
+The strategy here is to clamp neighbors back
 into the source rectangle, if they are out of bounds.
 
 Other strategies could be to use a different abyss policy?
+
+The brushfire works on a plane of one byte states,
+converted from tile memory in one pass, and written back in one pass.
+The direction channel is never copied, it passes from src to dst tiles.
+
+When strip_height is positive, instead stream strips of that many rows,
+see hysteresis_strips.
+
+When max_passes is positive, stop the brushfire after that many passes,
+though the fire is not out: an approximation, for previews,
+some weak pixels on long chains are not promoted.
+Then the rect is processed in memory, whatever strip_height:
+bounded passes are for small rects, a view.
+
+When remove_weak, the output is binary, the final result of canny:
+white where strong (white, or promoted), else black.
+Fused into the write back, instead of another threshold over the whole image.
+
+Reports to progress, and stops early when it is cancelled,
+between passes or strips, leaving dst partly written.
+Progress can be NULL.
+
+Fills stats, unless NULL.
+Counting costs little: promotions per pass are counted anyway,
+and pixel states are counted in the loop that writes them.
 */
 void
 hysteresis
@@ -185,9 +645,21 @@ hysteresis
   const GeglRectangle *src_rect,
   GeglBuffer          *dst,
   const GeglRectangle *dst_rect,
-  const Babl          *format)
+  const Babl          *format,
+  gint                 strip_height,
+  gint                 max_passes,
+  gboolean             remove_weak,
+  OpProgress          *progress,
+  HysteresisStats     *stats)
 {
-  gfloat *src_buf;  // array
+  guint8           *states;  // working plane
+  GeglRectangle     bounds;  // of the pixels not black, in the plane
+  HysteresisStats   local_stats;
+  BootchkHystCounts counts = { 0, 0, 0 };
+
+  if (stats == NULL)
+    stats = &local_stats;
+  memset (stats, 0, sizeof (*stats));
 
   // Require the source and destination rectangles are the same size.
   g_return_if_fail (src_rect->width == dst_rect->width &&
@@ -198,28 +670,56 @@ hysteresis
   if (src_rect->width <= 0 || src_rect->height <= 0)
     return; // Nothing to process.
 
-  {
-    guint size = src_rect->width * src_rect->height * FPP;
-  
-    src_buf = g_new0 (gfloat, size);
-    g_return_if_fail (src_buf != NULL );
-  }
+  if (strip_height > 0 && max_passes <= 0)
+    {
+      /* Streaming labels one rect, so src and dst must coincide, as they do in the op. */
+      g_return_if_fail (gegl_rectangle_equal (src_rect, dst_rect));
+
+      hysteresis_strips (src, src_rect, dst, format, strip_height, remove_weak, progress, stats);
+      return;
+    }
 
-  gegl_buffer_get (src, src_rect, 1.0,
-    /* Operation only allows one format, same as set on operation. */
-    format,
-    src_buf, GEGL_AUTO_ROWSTRIDE,
-    /* Abyss policy not "clamp" because we are doing our own clamping.*/
-    GEGL_ABYSS_NONE);
+  states = g_new (guint8, (gsize) src_rect->width * src_rect->height);
+  stats->allocated = (gsize) src_rect->width * src_rect->height;
+
+  read_state_plane (src, src_rect, format, states);
+
+  bounds = states_bounds (states, src_rect->width, src_rect->height);
+  g_debug ("%s burning %d x %d of %d x %d", G_STRFUNC,
+           bounds.width, bounds.height, src_rect->width, src_rect->height);
 
   // The brush fire loop continues until no more pixels are promoted.
   // The count of iterations is limited by the length of the longest connected path.
-  while (brushfire (src_buf, src_rect)) {}
+  // That count is not known in advance, so progress approaches, but never reaches, done.
+  // Or until max_passes, when bounded.
+  for (;;)
+    {
+      gsize promoted_count = bounds.width > 0 ? brushfire (states, &bounds, src_rect->width) : 0;
+      gchar message[64];
+
+      stats->passes++;
+      stats->promotions += promoted_count;
+
+      if (promoted_count == 0 || stats->passes == max_passes)
+        break;
+
+      if (op_progress_is_cancelled (progress))
+        {
+          g_free (states);
+          return;
+        }
+
+      g_snprintf (message, sizeof (message), "Hysteresis pass %d", stats->passes);
+      op_progress_report (progress, 0.9 * stats->passes / (stats->passes + 1.0), message);
+    }
+
+  g_debug ("%s after brush fire loop, %d passes", G_STRFUNC, stats->passes);
+
+  write_state_plane (src, src_rect, dst, dst_rect, format, states, remove_weak, &counts);
 
-  g_debug ("%s after brush fire loop", G_STRFUNC);
+  stats->strong = counts.strong;
+  stats->weak   = counts.weak;
+  stats->none   = counts.none;
 
-  // Set destination buffer with processed data, mutated src_buf!!!
-  gegl_buffer_set (dst, dst_rect, 0, format, src_buf,
-                   GEGL_AUTO_ROWSTRIDE);
-  g_free (src_buf);
+  g_free (states);
 }
@@ -1,9 +1,28 @@
 
 
+/*
+Statistics of one hysteresis, for logging,
+and to spot inputs whose long weak chains take many passes.
+*/
+typedef struct
+{
+  gint    passes;      // over the image: brushfire passes, or 2 when streaming strips
+  guint64 promotions;  // weak pixels promoted to strong
+  guint64 strong;      // pixels by final state: white, or promoted
+  guint64 weak;        // not promoted
+  guint64 none;        // black
+  gsize   allocated;   // bytes of working planes, strips and labels
+} HysteresisStats;
+
 void
 hysteresis
  (GeglBuffer          *src,
   const GeglRectangle *src_rect,
   GeglBuffer          *dst,
   const GeglRectangle *dst_rect,
-  const Babl          *format);
\ No newline at end of file
+  const Babl          *format,
+  gint                 strip_height,
+  gint                 max_passes,
+  gboolean             remove_weak,
+  OpProgress          *progress,
+  HysteresisStats     *stats);
\ No newline at end of file
@@ -2,6 +2,13 @@
 
 #ifdef GEGL_PROPERTIES
 
+property_boolean (squared, "Squared magnitude", FALSE)
+  description ("The magnitude channel is squared, as from a gradient without the square root. "
+               "Suppresses exactly as the magnitudes would, and outputs them squared.")
+
+property_boolean (half, "Half floats", FALSE)
+  description ("Input and output are IEEE half floats, half the bytes, "
+               "computed in float.")
 
 #else
 
@@ -16,6 +23,10 @@
 // Base on the above definitions, gegl-op.h generates code for the operation
 #include "gegl-op.h"
 
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-progress.h"
+#include "op-trace.h"
 #include "non-max-gradient-suppress.h"
 
 
@@ -25,8 +36,11 @@ static void prepare (GeglOperation *operation)
   /* 
   Format is float[2],  magnitude and direction channels.
   Not colors, not having a colorspace.
+  Or half[2], when half.
   */
-  const Babl *gradient_format= babl_format_n (babl_type ("float"), 2);
+  const Babl *gradient_format = GEGL_PROPERTIES (operation)->half
+                                ? bootchk_gradient_half_format ()
+                                : bootchk_gradient_format ();
 
   /*
   Set the area filter's left, right, top, and bottom padding to 1 pixel.
@@ -57,23 +71,37 @@ process (GeglOperation       *operation,
   Said padding is produced by the gegl_buffer_get() call.
   */
   GeglRectangle computed_in_rect = gegl_operation_get_required_for_output (operation, "input", out_rect);
+  OpProgress    progress;
+  OpTrace       trace;
+  gboolean      completed;
   
   g_debug ("%s in buffer format %s", G_STRFUNC, babl_format_get_encoding (gegl_buffer_get_format (input)));
   g_debug ("%s in op format %s", G_STRFUNC, babl_format_get_encoding (gegl_operation_get_format (operation, "input")));
   g_debug ("%s out op format %s", G_STRFUNC, babl_format_get_encoding (gegl_operation_get_format (operation, "output")));
 
-  non_maximum_suppression (
+  op_trace_begin (&trace, operation, out_rect);
+  op_progress_begin (&progress, operation, out_rect);
+
+  op_trace_bytes (&trace, non_maximum_suppression (
     input,
     &computed_in_rect,  // input rectangle, larger than the output rectangle
     output, 
     out_rect,
-    /* 
-    Using format of input buffer, which is float[2],
-    Using format (Y'A) does not work, it gives 1.0 for direction.
+    /*
+    The format set in prepare, float[2] or half[2], not the format of the input buffer:
+    a filter's input buffer is not converted, it is upstream's, e.g. one channel.
+    Not Y'A either, that gives 1.0 for direction.
     */
-    gegl_buffer_get_format (input));
+    gegl_operation_get_format (operation, "input"),
+    GEGL_PROPERTIES (operation)->half,
+    GEGL_PROPERTIES (operation)->squared,
+    &progress));
 
-  return TRUE;
+  completed = op_progress_end (&progress);
+  op_trace_end (&trace);
+
+  // Partial when cancelled, not the result, see op-progress.h.
+  return completed;
 }
 
 static void
@@ -95,6 +123,9 @@ gegl_op_class_init (GeglOpClass *klass)
   operation_class->opencl_support = FALSE;
   operation_class->threaded       = FALSE;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
     "title",       "Non-Max Gradient Suppress",
     "name",        "bootchk:non-max-gradient-suppress",
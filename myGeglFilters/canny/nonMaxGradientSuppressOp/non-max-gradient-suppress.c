@@ -1,6 +1,11 @@
 
+#include <string.h>
+
 #include <gegl.h>
 
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-progress.h"
 #include "non-max-gradient-suppress.h"
 
 
@@ -10,147 +15,221 @@
 
 
 /*
-Define the clamped axis for gradient directions.
+The suppression itself, of a span of a row, is bootchk_nms_span,
+in the kernels library.
+Here is the traversal of the buffers: chunks of tile memory, and their halos.
+*/
 
-Clamp gradient vectors to the nearest 45 degree axis.
 
-The axis NS (North-South) is 0 degrees.
-There are four axes (not eight).
+/*
+The halo of a chunk: the one pixel border around a chunk of the iterator.
 
-Up and down vectors, north to south and south to north, are clamped to the same axis.
+Pixels of the chunk itself are read directly from tile memory.
+Only the border around the chunk is copied, into this small cache.
+The corners are in the top and bottom rows.
 */
+typedef struct
+{
+  gfloat *top;     // width + 2 pixels
+  gfloat *bottom;  // width + 2 pixels
+  gfloat *left;    // height pixels
+  gfloat *right;   // height pixels
+} ChunkHalo;
+
 
-typedef enum
+/*
+Fill the halo of the chunk at roi from the src buffer.
+
+Abyss policy "clamp" initializes border pixels outside the source
+to the nearest actual source pixel value.
+When gradient direction is orthogonal across the edge of the image,
+an edge pixel will never be a local maximum
+since it will have a neighbor equal to itself.
+When gradient direction is along the edge of the image,
+or diagonal across the edge of the image,
+an edge pixel can be a local maximum and can be thinned.
+
+Returns the count of bytes copied.
+*/
+static gsize
+fetch_halo (
+  GeglBuffer          *src,
+  const GeglRectangle *roi,
+  const Babl          *format,
+  ChunkHalo           *halo)
 {
-  AXIS_NS   = 0,
-  AXIS_NW_SE,
-  AXIS_EW,
-  AXIS_SW_NE
-} DirectionAxis;
+  GeglRectangle top    = { roi->x - 1,          roi->y - 1,           roi->width + 2, 1 };
+  GeglRectangle bottom = { roi->x - 1,          roi->y + roi->height, roi->width + 2, 1 };
+  GeglRectangle left   = { roi->x - 1,          roi->y,               1, roi->height };
+  GeglRectangle right  = { roi->x + roi->width, roi->y,               1, roi->height };
 
+  gegl_buffer_get (src, &top,    1.0, format, halo->top,    GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gegl_buffer_get (src, &bottom, 1.0, format, halo->bottom, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gegl_buffer_get (src, &left,   1.0, format, halo->left,   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+  gegl_buffer_get (src, &right,  1.0, format, halo->right,  GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+
+  return (2 * (roi->width + 2) + 2 * roi->height) * FPP * sizeof (gfloat);
+}
 
 /*
-Gradient is two channels, second is an angle in radians [-pi, pi],
-using the East-Counterclockwise Convention
-(0 degrees is East, 90 degrees is North, 180 degrees is West, -90 degrees is South)
-i.e. computed by atan2 (dy, dx).
-
-The implementation is not efficient, but it is simple and clear.
-That is, we don't need to convert convention, normalize, or work in degrees,
-except for intuitive understanding of the result.
+Pointer to the pixel at row, col of a chunk, relative to the chunk origin.
+Row in [-1, height], col in [-1, width].
+Inside the chunk, points into tile memory, else into the halo.
 */
-static DirectionAxis
-clamped_axis_of_vector (gfloat *vector)
+static const gfloat *
+chunk_pixel (
+  const ChunkHalo *halo,
+  const gfloat    *chunk,
+  gint             width,
+  gint             height,
+  gint             row,
+  gint             col)
 {
-  gfloat angle = vector[1];
-
-  //if (angle != 1.0)
-  //  g_debug ("%s: angle in radians = %f", G_STRFUNC, angle);
-
-  // Normalize angle to [0, 2 pi) degrees.
-  if (angle < 0)
-    angle += 2 * G_PI; // Convert negative angle to positive.
-  else if (angle >= 2 * G_PI)
-    angle -= 2 * G_PI; // Convert angle greater than 2 pi  to [0, 2 pi).
-
-  // Convert radians to degrees.
-  angle = angle * 180.0 / G_PI;
-
-  //g_debug ("%s: angle in degrees = %f", G_STRFUNC, angle);
-
-  // Remember that the angle is in East-Counterclockwise Convention.
-  if (angle < 22.5 || angle >= 337.5)
-    return AXIS_EW;
-  else if (angle >= 22.5 && angle < 67.5)
-    return AXIS_NW_SE;
-  else if (angle >= 67.5 && angle < 112.5)
-    return AXIS_NS;
-  else if (angle >= 112.5 && angle < 157.5)
-    return AXIS_SW_NE;
-  else if (angle >= 157.5 && angle < 202.5)
-    return AXIS_EW;
-  else if (angle >= 202.5 && angle < 247.5)
-    return AXIS_NW_SE;
-  else if (angle >= 247.5 && angle < 292.5)
-    return AXIS_NS;
+  if (row < 0)
+    return halo->top + (col + 1) * FPP;
+  else if (row >= height)
+    return halo->bottom + (col + 1) * FPP;
+  else if (col < 0)
+    return halo->left + row * FPP;
+  else if (col >= width)
+    return halo->right + row * FPP;
   else
-    // angle >= 292.5 && angle < 337.5
-    return AXIS_SW_NE;
+    return chunk + (row * width + col) * FPP;
 }
 
 /*
-Check if center is a local maximum magnitude
-in the clamped direction of the gradient.
+Suppress one pixel on the border of a chunk.
+Its neighbors are partly in the halo,
+so gather them into a small 3x3 neighborhood first.
+*/
+static void
+suppress_border_pixel (
+  const ChunkHalo *halo,
+  const gfloat    *chunk,
+  gfloat          *out_chunk,
+  gint             width,
+  gint             height,
+  gint             row,
+  gint             col,
+  gboolean         squared,
+  BootchkNmsSpanFunc nms_span)
+{
+  gfloat neighborhood[3][3 * FPP];
+  gint   i, j;
+
+  for (i = 0; i < 3; i++)
+    for (j = 0; j < 3; j++)
+      {
+        const gfloat *pixel = chunk_pixel (halo, chunk, width, height,
+                                           row + i - 1, col + j - 1);
+
+        neighborhood[i][j * FPP]     = pixel[0];
+        neighborhood[i][j * FPP + 1] = pixel[1];
+      }
+
+  nms_span (neighborhood[0] + FPP, neighborhood[1] + FPP, neighborhood[2] + FPP,
+            out_chunk + (row * width + col) * FPP,
+            1, squared);
+}
 
-Local with respect to two neighbor pixel gradient magnitudes.
 
-All arguments are pointers to pixels
-having two channels: magnitude and direction,
-representing a vector at that pixel.
+/*
+Suppress a chunk of width x height, its halo already fetched.
+Nms_span is bootchk_nms_span of the CPU, resolved once by the caller,
+not dispatched for each pixel of the border.
 */
-static gboolean
-is_gradient_magnitude_a_local_maximum(
-  gfloat *top_left,    gfloat *top,    gfloat *top_right,
-  gfloat *left,        gfloat *center, gfloat *right,
-  gfloat *bottom_left, gfloat *bottom, gfloat *bottom_right
-)
+static void
+suppress_chunk (
+  const ChunkHalo *halo,
+  const gfloat    *chunk,
+  gfloat          *out_chunk,
+  gint             width,
+  gint             height,
+  gboolean         squared,
+  BootchkNmsSpanFunc nms_span)
 {
-  gboolean result = FALSE;
-
-  // g_debug ("%s", G_STRFUNC);
-
-  switch ( clamped_axis_of_vector (center) )
-  {
-    // Is center magnitude greater than its...
-    case AXIS_NS:
-      // vertical neighbors?
-      result = (center[0] > top[0] && center[0] > bottom[0]);
-      break;
-    case AXIS_NW_SE:
-      // first diagonal neighbors?
-      result = (center[0] > top_left[0] && center[0] > bottom_right[0]);
-      break;
-    case AXIS_EW:
-      // horizontal neighbors?
-      result = (center[0] > left[0] && center[0] > right[0]);
-      break;
-    case AXIS_SW_NE:
-      // second diagonal neighbors?
-      result = (center[0] > bottom_left[0] && center[0] > top_right[0]);
-      break;
-    default:
-      g_error ( "Unexpected value of gradient direction");
-      // If we reach here, programming error.
-      result= FALSE;
-  }
-  
-  return result;
+  gint row, col;
+
+  /* Interior of the chunk: all neighbors are in tile memory. */
+  for (row = 1; row < height - 1; row++)
+    {
+      const gfloat *mid = chunk + (row * width + 1) * FPP;
+
+      nms_span (mid - width * FPP,
+                mid,
+                mid + width * FPP,
+                out_chunk + (row * width + 1) * FPP,
+                width - 2,
+                squared);
+    }
+
+  /* Border of the chunk: first and last rows, first and last columns. */
+  for (row = 0; row < height; row++)
+    {
+      gint step = (row == 0 || row == height - 1) ? 1 : MAX (width - 1, 1);
+
+      for (col = 0; col < width; col += step)
+        suppress_border_pixel (halo, chunk, out_chunk,
+                               width, height, row, col, squared, nms_span);
+    }
 }
 
+
 /*
-Src and dst are format YA.
+Src and dst are read and written in format, float[2],
+or half[2] (bootchk_gradient_half_format) when half.
+Format must have FPP components, whatever the format of the buffers:
+GEGL converts, the chunks are indexed FPP floats (or halfs) per pixel.
 Interpreted as a gradient field: an array of vectors.  
 A vector has two components, magnitude and direction.
 
-The source and destination rectangles are NOT the same size.
-The source rectangle is larger, using an abyss policy
-to initialze the extra pixels in the source buffer.
-The extra pixels a one pixel border around the destination rectangle.
+The source rectangle is larger than the destination rectangle,
+by a one pixel border.
+The border is only used for the neighbors of pixels on the edge of dst_rect.
 
-The coordinate systems are not the same.
-See below, converting from source to destination.
+Iterates over the dst rectangle in chunks (tiles) of the buffers,
+reading and writing tile memory directly.
+The chunks of src and dst have the same coordinates.
+Only the one pixel halo around each chunk is copied out of src.
+
+Interior pixels of a chunk take a fast path, reading neighbors from tile memory.
+Pixels on the border of a chunk take a slower path, through the halo.
+
+When squared, the magnitudes are squared, see bootchk_nms_span.
+
+When half, each chunk is converted to floats in a scratch, suppressed,
+and converted back into tile memory. The halo is read as floats.
+So the tiles are half the bytes, and the scratch of one chunk stays in cache.
+
+A chunk all black, e.g. of the transparent margin of a cut-out, is copied:
+its suppression is itself, whatever its halo, so the halo is not fetched.
+
+Reports to progress per chunk, and stops early when it is cancelled.
+Progress can be NULL.
+
+Returns the bytes allocated, for the halo cache and the scratch.
 */
-void
+gsize
 non_maximum_suppression
  (GeglBuffer          *src,
   const GeglRectangle *src_rect,
   GeglBuffer          *dst,
   const GeglRectangle *dst_rect,
-  const Babl          *format)
+  const Babl          *format,
+  gboolean             half,
+  gboolean             squared,
+  OpProgress          *progress)
 {
-  gfloat *src_buf, *dst_buf;
-
-  // 
+  GeglBufferIterator *iter;
+  ChunkHalo           halo;
+  gint                halo_capacity = 0;
+  gsize               copied_bytes = 0;
+  gdouble             done_pixels = 0;
+  const Babl         *halo_format = bootchk_gradient_format ();
+  gfloat             *scratch = NULL;  // when half, a chunk of src, then of dst, as floats
+  gsize               scratch_capacity = 0;
+  guint               black_chunks = 0;
+  BootchkNmsSpanFunc  nms_span = bootchk_nms_span_func ();
 
   g_debug ("%s", G_STRFUNC);
 
@@ -158,117 +237,91 @@ non_maximum_suppression
            src_rect->width, src_rect->height,
            dst_rect->width, dst_rect->height);
 
-  if (src_rect->width <= 0 || src_rect->height <= 0)
-    return; // Nothing to process.
-
-  // Different size
-  src_buf = g_new0 (gfloat, src_rect->width * src_rect->height * FPP);
-  dst_buf = g_new0 (gfloat, dst_rect->width * dst_rect->height * FPP);
-
-  /* 
-  Abyss policy "clamp" initializes extra, border pixels in source to nearest actual source pixel value.
-  When gradient direction is orthogonal across the edge of the image,
-  an edge pixel will never be a local maximum
-  since it will have a neighbor equal to itself.
-  When gradient direction is along the edge of the image,
-  or diagonal across the edge of the image,
-  an edge pixel can be a local maximum and can be thinned.
-  */
-
-  gegl_buffer_get (src, src_rect, 1.0,
-    /* Operation only allows one format, same as set on operation. */
-    format,
-    src_buf, GEGL_AUTO_ROWSTRIDE,
-    GEGL_ABYSS_CLAMP);
-
-  g_debug ("%s before scan", G_STRFUNC);
-
-  /*
-  Raster scan the dest rectangle.
-  Derived from edge-sobel.c
-  */ 
-  {
-    guint dest_col, dest_row;
-    gint dest_index = 0;
-
-  for (dest_row = 0; dest_row < dst_rect->height; dest_row++)
+  g_return_val_if_fail (babl_format_get_n_components (format) == FPP, 0);
+
+  if (dst_rect->width <= 0 || dst_rect->height <= 0)
+    return 0; // Nothing to process.
+
+  halo.top = halo.bottom = halo.left = halo.right = NULL;
+
+  iter = gegl_buffer_iterator_new (dst, dst_rect, 0, format,
+                                   GEGL_ACCESS_WRITE, GEGL_ABYSS_NONE, 2);
+  gegl_buffer_iterator_add (iter, src, dst_rect, 0, format,
+                            GEGL_ACCESS_READ, GEGL_ABYSS_NONE);
+
+  while (gegl_buffer_iterator_next (iter))
     {
-      // gfloat *dest_row_start = src_buf + dest_row * src_rect->width * FPP;
-     
-      /*
-      Start of source row is one row past dest_row. 
-      The first row is a row of extra pixels, artificial neighbors above the second row.
-      */
-      gfloat *source_row_start_ptr = src_buf + (dest_row + 1)  * src_rect->width * FPP;
-
-      for (dest_col = 0; dest_col < dst_rect->width; dest_col++)
+      gfloat       *out_chunk = iter->items[0].data;
+      const gfloat *chunk     = iter->items[1].data;
+      GeglRectangle roi       = iter->items[0].roi;
+      gsize         n         = (gsize) roi.width * roi.height * FPP;
+
+      if (half)
         {
-          /* Pointers to neighbors. */
-          gfloat *top_left,    *top,     *top_right;
-          gfloat *left,        *center,  *right;
-          gfloat *bottom_left, *bottom,  *bottom_right;
-
-          /* 
-          Compute pointers to neighbor pixels in source buffer.
-          Using address arithmetic.
-          Assert calculated pointers are in bounds of source rect.
-          */
-
-          /* source_col_index is one pixel more than dest col. */
-          gint source_col_index = dest_col + 1;
-
-          center       = source_row_start_ptr + source_col_index * FPP;
-
-          /* Left and right are one pixel previous and following. */
-          left         = center - FPP;
-          right        = center + FPP;
-
-          /* Top is one row width previous. */
-          top          = center - src_rect->width * FPP;
-          top_left     = top - FPP;
-          top_right    = top + FPP;
-          
-          bottom       = center + src_rect->width * FPP;
-          bottom_left  = bottom - FPP;
-          bottom_right = bottom + FPP;
-
-          /* Assert pointers to neighbors are in bounds of source rect */
-          
-          /*
-          Perform the filtering, to the output buffer.
-          When center is local maximum, 
-          keep magnitude component,
-          else discard (set to zero).
-          */
-          if (is_gradient_magnitude_a_local_maximum(
-                top_left, top, top_right,
-                left, center, right,
-                bottom_left, bottom, bottom_right))
+          if (2 * n > scratch_capacity)
             {
-              // keep its magnitude component.
-              dst_buf[dest_index] = center[0];
-            } 
-          else 
+              scratch_capacity = 2 * n;
+              scratch = g_renew (gfloat, scratch, scratch_capacity);
+            }
+
+          bootchk_half_to_float (iter->items[1].data, scratch, n);
+          chunk     = scratch;
+          out_chunk = scratch + n;
+        }
+
+      if (bootchk_is_black (chunk, n / FPP))
+        {
+          /* Copy the tile memory, in the format of the buffers, so no conversion when half. */
+          memcpy (iter->items[0].data, iter->items[1].data,
+                  n * (half ? sizeof (guint16) : sizeof (gfloat)));
+          black_chunks++;
+        }
+      else
+        {
+          /* Grow the halo cache when a chunk is larger than any before. */
+          if (MAX (roi.width + 2, roi.height) > halo_capacity)
             {
-              dst_buf[dest_index] = 0;  // viewed as black
+              halo_capacity = MAX (roi.width + 2, roi.height);
+              halo.top    = g_renew (gfloat, halo.top,    halo_capacity * FPP);
+              halo.bottom = g_renew (gfloat, halo.bottom, halo_capacity * FPP);
+              halo.left   = g_renew (gfloat, halo.left,   halo_capacity * FPP);
+              halo.right  = g_renew (gfloat, halo.right,  halo_capacity * FPP);
             }
 
-          // Keep direction component, unchanged.
-          dst_buf[dest_index + 1] = center[1];
+          copied_bytes += fetch_halo (src, &roi, halo_format, &halo);
 
-          // Increment the destination index.
-          dest_index += FPP;
+          suppress_chunk (&halo, chunk, out_chunk, roi.width, roi.height, squared, nms_span);
 
-          // g_debug ("dst_buf[%d] = %f", dest_index, dst_buf[dest_index]);
-        } // End of inner loop over dest_col
-    } // End of outer loop over dest_row
-  } // End of raster scan.
+          if (half)
+            bootchk_float_to_half (out_chunk, iter->items[0].data, n);
+        }
 
-  g_debug ("%s after scan", G_STRFUNC);
+      done_pixels += roi.width * roi.height;
+      op_progress_report (progress,
+                          done_pixels / ((gdouble) dst_rect->width * dst_rect->height),
+                          "Non-max suppression");
 
-  // Set the destination buffer with the processed data.
-  gegl_buffer_set (dst, dst_rect, 0, format, dst_buf,
-                   GEGL_AUTO_ROWSTRIDE);
-  g_free (src_buf);
-  g_free (dst_buf);
+      if (op_progress_is_cancelled (progress))
+        {
+          gegl_buffer_iterator_stop (iter);
+          break;
+        }
+    }
+
+  g_free (halo.top);
+  g_free (halo.bottom);
+  g_free (halo.left);
+  g_free (halo.right);
+  g_free (scratch);
+
+  /* Compare to copying the whole src_rect out and the whole dst_rect back in. */
+  g_debug ("%s copied %" G_GSIZE_FORMAT " bytes, whole rect copies would be %" G_GSIZE_FORMAT
+           ", %u black chunks copied",
+           G_STRFUNC,
+           copied_bytes,
+           (gsize) (src_rect->width * src_rect->height + dst_rect->width * dst_rect->height)
+             * FPP * sizeof (gfloat),
+           black_chunks);
+
+  return (4 * (gsize) halo_capacity * FPP + scratch_capacity) * sizeof (gfloat);
 }
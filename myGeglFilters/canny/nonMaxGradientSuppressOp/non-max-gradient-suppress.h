@@ -1,9 +1,12 @@
 
 
-void
+gsize
 non_maximum_suppression
  (GeglBuffer          *src,
   const GeglRectangle *src_rect,
   GeglBuffer          *dst,
   const GeglRectangle *dst_rect,
-  const Babl          *format);
\ No newline at end of file
+  const Babl          *format,
+  gboolean             half,
+  gboolean             squared,
+  OpProgress          *progress);
\ No newline at end of file
@@ -0,0 +1,96 @@
+#include <gegl.h>
+#include <gegl-plugin.h>
+
+#include "bootchk-kernels.h"
+#include "op-progress.h"
+#include "area-filter.h"
+
+
+
+
+/* Pixels per strip, with the ring around it, a few hundred KB: in the L2 cache. */
+#define STRIP_PIXELS (32 * 1024)
+
+/* The buffers of the callbacks of BootchkAreaStrips. */
+typedef struct
+{
+  GeglBuffer          *input;
+  GeglBuffer          *output;
+  const GeglRectangle *roi;
+  const Babl          *in_format;
+  const Babl          *out_format;
+  gint                 radius;
+  OpProgress          *progress;
+} AreaBuffers;
+
+
+static void
+fetch_rows (void *data, int y, int n_rows, float *rows)
+{
+  AreaBuffers  *buffers = data;
+  GeglRectangle rect    = { buffers->roi->x - buffers->radius, buffers->roi->y + y,
+                            buffers->roi->width + 2 * buffers->radius, n_rows };
+
+  gegl_buffer_get (buffers->input, &rect, 1.0, buffers->in_format, rows,
+                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
+}
+
+static int
+store_rows (void *data, int y, int n_rows, const float *rows)
+{
+  AreaBuffers  *buffers = data;
+  GeglRectangle rect    = { buffers->roi->x, buffers->roi->y + y, buffers->roi->width, n_rows };
+
+  gegl_buffer_set (buffers->output, &rect, 0, buffers->out_format, rows, GEGL_AUTO_ROWSTRIDE);
+
+  op_progress_report (buffers->progress, (y + n_rows) / (gdouble) buffers->roi->height, "Area filter");
+
+  return op_progress_is_cancelled (buffers->progress);
+}
+
+
+gsize
+area_filter_process (GeglOperation         *operation,
+                     GeglBuffer            *input,
+                     GeglBuffer            *output,
+                     const GeglRectangle   *roi,
+                     const Babl            *in_format,
+                     const Babl            *out_format,
+                     void                 (*filter) (void               *data,
+                                                     const float *const *rows,
+                                                     float              *out,
+                                                     int                 width),
+                     gpointer               data,
+                     OpProgress            *progress)
+{
+  GeglOperationAreaFilter *area    = GEGL_OPERATION_AREA_FILTER (operation);
+  AreaBuffers              buffers = { input, output, roi, in_format, out_format, 0, progress };
+  BootchkAreaStrips        strips;
+  gsize                    n_floats;
+  gfloat                  *scratch;
+
+  // Symmetric, the largest side: a side padded more than it needs is only read, never used.
+  buffers.radius = MAX (MAX (area->left, area->right), MAX (area->top, area->bottom));
+  g_return_val_if_fail (buffers.radius <= BOOTCHK_AREA_MAX_RADIUS, 0);
+
+  strips.width          = roi->width;
+  strips.height         = roi->height;
+  strips.radius         = buffers.radius;
+  strips.in_components  = babl_format_get_n_components (in_format);
+  strips.out_components = babl_format_get_n_components (out_format);
+  strips.strip_rows     = CLAMP (STRIP_PIXELS / (roi->width + 2 * buffers.radius), 1, roi->height);
+  strips.fetch          = fetch_rows;
+  strips.filter         = filter;
+  strips.store          = store_rows;
+  strips.data           = &buffers;
+  strips.filter_data    = data;
+
+  n_floats = bootchk_area_scratch_floats (&strips);
+  scratch  = gegl_scratch_new (gfloat, n_floats);
+
+  bootchk_area_run (&strips, scratch);
+
+  gegl_scratch_free (scratch);
+
+  return n_floats * sizeof (gfloat);
+}
@@ -0,0 +1,31 @@
+/*
+The process of an area filter op, by strips of rows, see BootchkAreaStrips.
+
+For new area ops, copied from examples/areaOp:
+the op writes only the filter of a row, from the rows around it,
+and this streams the roi through it.
+Per strip, one gegl_buffer_get of the rows not yet fetched, with their padding,
+clamped at the abyss, and one gegl_buffer_set of the output rows.
+Memory is a ring of rows and a strip, in the L2 cache, not the roi:
+scratch of GEGL's pool, per thread, so ops can be threaded.
+
+The radius is the largest padding of the area filter, set in prepare.
+*/
+
+/*
+Filter the roi of input into output, by filter (data its first argument).
+Progress, unless NULL, is reported per strip, and stops the filter when cancelled.
+Returns the bytes of scratch, for op_trace_bytes.
+*/
+gsize area_filter_process (GeglOperation         *operation,
+                           GeglBuffer            *input,
+                           GeglBuffer            *output,
+                           const GeglRectangle   *roi,
+                           const Babl            *in_format,
+                           const Babl            *out_format,
+                           void                 (*filter) (void               *data,
+                                                           const float *const *rows,
+                                                           float              *out,
+                                                           int                 width),
+                           gpointer               data,
+                           OpProgress            *progress);
@@ -0,0 +1,33 @@
+
+
+
+/*
+The pixel format of a gradient field, as passed between the stages of canny:
+two floats, magnitude (or its square) and direction in radians.
+
+An n-component format, not colors: babl never interprets the channels,
+as it would with Y'A float, where the direction as alpha
+was premultiplied or clamped ("gives 1.0 for direction".)
+
+Every stage from the gradient through the input of hysteresis declares this format,
+for its input and output, so GEGL passes their buffers without a babl conversion.
+Run with BOOTCHK_TRACE to check: the events count the conversions of each op's input.
+*/
+static inline const Babl *
+bootchk_gradient_format (void)
+{
+  return babl_format_n (babl_type ("float"), 2);
+}
+
+/*
+The same of IEEE half floats, two bytes a channel, when canny's half property is set:
+half the bytes of tiles, cache, and swap between the stages.
+The ops compute in float, converting each chunk, see bootchk_half_to_float.
+A half has 11 significant bits, so thresholds and NMS comparisons
+can differ from float for magnitudes within a part in 2048 of each other.
+*/
+static inline const Babl *
+bootchk_gradient_half_format (void)
+{
+  return babl_format_n (babl_type ("half"), 2);
+}
@@ -0,0 +1,101 @@
+#include <gegl.h>
+#include <gegl-plugin.h>
+
+#include "op-progress.h"
+
+
+
+
+/* Report at most this often, as a fraction of the stage. */
+#define REPORT_STEP 0.01
+
+
+static void
+on_invalidated (GeglNode            *node,
+                const GeglRectangle *rect,
+                gpointer             data)
+{
+  OpProgressShared *shared = data;
+
+  if (rect == NULL || gegl_rectangle_intersect (NULL, rect, &shared->roi))
+    g_atomic_int_set (&shared->cancelled, TRUE);
+}
+
+/* Of the handler's closure: released when disconnected and no emission is running it. */
+static void
+release_shared (gpointer  data,
+                GClosure *closure)
+{
+  g_atomic_rc_box_release (data);
+}
+
+
+/* Start reporting for operation, computing roi. */
+void
+op_progress_begin (OpProgress          *progress,
+                   GeglOperation       *operation,
+                   const GeglRectangle *roi)
+{
+  progress->operation         = operation;
+  progress->reported          = 0.0;
+  progress->shared            = g_atomic_rc_box_new0 (OpProgressShared);
+  progress->shared->roi       = *roi;
+  progress->shared->cancelled = FALSE;
+  progress->handler           = g_signal_connect_data (operation->node, "invalidated",
+                                                       G_CALLBACK (on_invalidated),
+                                                       g_atomic_rc_box_acquire (progress->shared),
+                                                       release_shared, 0);
+
+  gegl_operation_progress (operation, 0.0, "");
+}
+
+/*
+Report fraction done, in [0, 1], with a message.
+Throttled, so a stage can call it per row or per chunk.
+*/
+void
+op_progress_report (OpProgress  *progress,
+                    gdouble      fraction,
+                    const gchar *message)
+{
+  if (progress == NULL)
+    return;
+
+  if (fraction < 1.0 && fraction - progress->reported < REPORT_STEP)
+    return;
+
+  progress->reported = fraction;
+  gegl_operation_progress (progress->operation, fraction, (gchar *) message);
+}
+
+gboolean
+op_progress_is_cancelled (OpProgress *progress)
+{
+  if (progress == NULL)
+    return FALSE;
+
+  return g_atomic_int_get (&progress->shared->cancelled);
+}
+
+/*
+Stop reporting. Reports done, even when cancelled, so a progress bar goes away.
+FALSE when cancelled: the output is partial, process returns it, see op-progress.h.
+*/
+gboolean
+op_progress_end (OpProgress *progress)
+{
+  gboolean cancelled;
+
+  g_signal_handler_disconnect (progress->operation->node, progress->handler);
+
+  cancelled = op_progress_is_cancelled (progress);
+  if (cancelled)
+    g_debug ("%s: cancelled, the render is stale", G_STRFUNC);
+
+  g_atomic_rc_box_release (progress->shared);
+  progress->shared = NULL;
+
+  gegl_operation_progress (progress->operation, 1.0, "");
+
+  return ! cancelled;
+}
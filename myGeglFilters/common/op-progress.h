@@ -0,0 +1,52 @@
+
+
+
+/*
+Progress and cancellation for long running stages of an operation.
+
+A stage reports progress through GEGL (the "progress" signal of the node,
+which GIMP shows as a progress bar),
+and polls for cancellation between its strips or passes.
+
+A render is cancelled when the node is invalidated over the region being computed,
+e.g. a property changed, here or upstream, in GIMP's live preview.
+Then the render is stale, and finishing it only delays the next one.
+
+A cancelled stage returns early, its output partial:
+op_progress_end is then FALSE, which process returns,
+so GEGL doesn't take the partial output as the result.
+
+The "invalidated" signal can be emitted from another thread while process ends,
+so what its handler touches is not in the OpProgress, on the stack of process,
+but in a refcounted OpProgressShared, which the handler's closure holds a reference to,
+released by GLib after disconnecting, when no emission still runs the handler.
+
+All functions but begin and end accept a NULL progress, for stages called outside an operation:
+no reports, never cancelled.
+*/
+typedef struct
+{
+  GeglRectangle roi;        // region being computed
+  gint          cancelled;  // atomic, set from whatever thread invalidates
+} OpProgressShared;
+
+typedef struct
+{
+  GeglOperation    *operation;
+  OpProgressShared *shared;    // with the handler, refcounted, g_atomic_rc_box
+  gulong            handler;   // of the node's "invalidated" signal
+  gdouble           reported;  // last fraction reported
+} OpProgress;
+
+void     op_progress_begin        (OpProgress          *progress,
+                                   GeglOperation       *operation,
+                                   const GeglRectangle *roi);
+
+void     op_progress_report       (OpProgress          *progress,
+                                   gdouble              fraction,
+                                   const gchar         *message);
+
+gboolean op_progress_is_cancelled (OpProgress          *progress);
+
+/* Stop reporting. TRUE when the stage completed, FALSE when cancelled. */
+gboolean op_progress_end          (OpProgress          *progress);
@@ -0,0 +1,269 @@
+#define _GNU_SOURCE  // syscall
+
+#include <stdio.h>
+
+#include <gegl.h>
+#include <gegl-plugin.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "op-trace.h"
+
+
+
+
+/*
+The trace file, one per process.
+
+Each op is its own plug-in, with its own copy of this code and its statics.
+So the ops agree on one tracer through GEGL: it hangs as data on the GeglConfig singleton.
+The first op to trace creates it, the others find it.
+
+The file is written as a JSON array of events, one per line, flushed per event,
+and never closed: the viewers accept the array without its closing bracket,
+so the trace is usable even when the process is killed.
+*/
+#define TRACER_KEY "bootchk-op-tracer"
+
+typedef struct
+{
+  GMutex      mutex;  // held while writing an event, or timing a conversion
+  FILE       *file;   // NULL when it could not be opened
+  GHashTable *costs;  // of conversions, "from -> to" to microseconds per pixel
+} Tracer;
+
+
+static Tracer *
+claim_tracer (const gchar *path)
+{
+  GObject *config = G_OBJECT (gegl_config ());
+  Tracer  *tracer = g_new0 (Tracer, 1);
+
+  g_mutex_init (&tracer->mutex);
+  tracer->costs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+  /* Hold the new tracer until its file is open, in case another op finds it first. */
+  g_mutex_lock (&tracer->mutex);
+
+  if (g_object_replace_data (config, TRACER_KEY, NULL, tracer, NULL, NULL))
+    {
+      tracer->file = fopen (path, "w");
+
+      if (tracer->file == NULL)
+        g_warning ("%s: can't open BOOTCHK_TRACE %s", G_STRFUNC, path);
+      else
+        fputs ("[\n", tracer->file);
+
+      g_mutex_unlock (&tracer->mutex);
+      return tracer;
+    }
+
+  /* Another op created the tracer first. */
+  g_mutex_unlock (&tracer->mutex);
+  g_mutex_clear (&tracer->mutex);
+  g_hash_table_unref (tracer->costs);
+  g_free (tracer);
+
+  return g_object_get_data (config, TRACER_KEY);
+}
+
+/*
+The tracer of the module, NULL when BOOTCHK_TRACE is not set, after get_tracer looked.
+Set once, so a span that found it active reads it again without get_tracer.
+*/
+static gsize   tracer_once   = 0;
+static Tracer *module_tracer = NULL;
+
+/* The tracer, or NULL. Looks at the environment once, after that one test of a flag. */
+static inline Tracer *
+get_tracer (void)
+{
+  if (g_once_init_enter (&tracer_once))
+    {
+      const gchar *path = g_getenv ("BOOTCHK_TRACE");
+
+      if (path != NULL && *path != '\0')
+        module_tracer = claim_tracer (path);
+
+      g_once_init_leave (&tracer_once, 1);
+    }
+
+  return module_tracer;
+}
+
+/* The id of the calling thread, as the viewers label their tracks. */
+static gint64
+thread_id (void)
+{
+#ifdef __linux__
+  return syscall (SYS_gettid);
+#else
+  return (gint64) GPOINTER_TO_SIZE (g_thread_self ());
+#endif
+}
+
+static gint64
+process_id (void)
+{
+#ifdef G_OS_UNIX
+  return getpid ();
+#else
+  return 0;
+#endif
+}
+
+
+/* Pixels converted to time a conversion, once per pair of formats. */
+#define AUDIT_PIXELS (64 * 1024)
+
+/*
+Microseconds per pixel of babl converting from to to.
+Timed the first time the pair is asked for, on zeros, then kept by the tracer:
+a traced process pays for a conversion's timing once in the process, not per call.
+*/
+static gdouble
+conversion_cost (Tracer     *tracer,
+                 const Babl *from,
+                 const Babl *to)
+{
+  gchar   *pair = g_strdup_printf ("%s -> %s", babl_get_name (from), babl_get_name (to));
+  gdouble *cost;
+
+  g_mutex_lock (&tracer->mutex);
+
+  cost = g_hash_table_lookup (tracer->costs, pair);
+
+  if (cost == NULL)
+    {
+      gpointer src = g_malloc0 (AUDIT_PIXELS * babl_format_get_bytes_per_pixel (from));
+      gpointer dst = g_malloc (AUDIT_PIXELS * babl_format_get_bytes_per_pixel (to));
+      gint64   start;
+
+      start = g_get_monotonic_time ();
+      babl_process (babl_fish (from, to), src, dst, AUDIT_PIXELS);
+
+      cost  = g_new (gdouble, 1);
+      *cost = (g_get_monotonic_time () - start) / (gdouble) AUDIT_PIXELS;
+      g_hash_table_insert (tracer->costs, g_strdup (pair), cost);
+
+      g_free (src);
+      g_free (dst);
+    }
+
+  g_mutex_unlock (&tracer->mutex);
+  g_free (pair);
+
+  return *cost;
+}
+
+/*
+Does GEGL convert the input of the op, from the format upstream to the format of the op?
+GEGL converts where they differ, the op's reads of the buffer upstream going through babl:
+this makes the same test, on the formats negotiated: the op itself never sees the conversion.
+The time is an estimate, the pixels of the rect at the cost of the pair, see conversion_cost.
+*/
+static void
+audit_input (OpTrace *trace)
+{
+  GeglOperation *operation = trace->operation;
+  const Babl    *from;
+  const Babl    *to;
+
+  trace->from       = NULL;
+  trace->to         = NULL;
+  trace->convert_us = 0;
+
+  if (! gegl_node_has_pad (operation->node, "input"))
+    return;
+
+  from = gegl_operation_get_source_format (operation, "input");
+  to   = gegl_operation_get_format (operation, "input");
+
+  if (from == NULL || to == NULL || from == to)
+    return;
+
+  trace->convert_us = conversion_cost (module_tracer, from, to)
+                      * trace->rect.width * trace->rect.height;
+  trace->from       = from;
+  trace->to         = to;
+}
+
+
+/* Start a span of operation, computing rect. */
+void
+op_trace_begin (OpTrace             *trace,
+                GeglOperation       *operation,
+                const GeglRectangle *rect)
+{
+  trace->active = get_tracer () != NULL;
+
+  if (! trace->active)
+    return;
+
+  trace->operation = operation;
+  trace->rect      = *rect;
+  trace->bytes     = 0;
+
+  audit_input (trace);
+
+  trace->start     = g_get_monotonic_time ();
+}
+
+/* Count bytes allocated by the op, e.g. for its working planes. */
+void
+op_trace_bytes (OpTrace *trace,
+                gsize    bytes)
+{
+  if (trace == NULL || ! trace->active)
+    return;
+
+  trace->bytes += bytes;
+}
+
+/* End the span, writing it as a "complete" event, timestamps in microseconds. */
+void
+op_trace_end (OpTrace *trace)
+{
+  Tracer *tracer = module_tracer;
+  gint64  end;
+
+  if (! trace->active)
+    return;
+
+  end = g_get_monotonic_time ();
+
+  g_mutex_lock (&tracer->mutex);
+
+  if (tracer->file != NULL)
+    {
+      fprintf (tracer->file,
+               "{\"name\":\"%s\",\"cat\":\"bootchk\",\"ph\":\"X\","
+               "\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ","
+               "\"pid\":%" G_GINT64_FORMAT ",\"tid\":%" G_GINT64_FORMAT ","
+               "\"args\":{\"x\":%d,\"y\":%d,\"width\":%d,\"height\":%d,"
+               "\"bytes\":%" G_GSIZE_FORMAT ",\"conversions\":%d,"
+               "\"convert_us\":%" G_GINT64_FORMAT ",\"convert\":\"%s%s%s\"}},\n",
+               gegl_operation_get_name (trace->operation),
+               trace->start, end - trace->start,
+               process_id (), thread_id (),
+               trace->rect.x, trace->rect.y, trace->rect.width, trace->rect.height,
+               trace->bytes,
+               trace->from != NULL,
+               trace->convert_us,
+               trace->from != NULL ? babl_get_name (trace->from) : "",
+               trace->from != NULL ? " -> " : "",
+               trace->from != NULL ? babl_get_name (trace->to) : "");
+      if (trace->from != NULL)
+        g_debug ("%s: %s converts its input, %s -> %s",
+                 G_STRFUNC, gegl_operation_get_name (trace->operation),
+                 babl_get_name (trace->from), babl_get_name (trace->to));
+      fflush (tracer->file);
+    }
+
+  g_mutex_unlock (&tracer->mutex);
+}
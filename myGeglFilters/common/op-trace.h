@@ -0,0 +1,47 @@
+
+
+
+/*
+A timeline of the operations, for chrome://tracing or ui.perfetto.dev.
+
+When the environment variable BOOTCHK_TRACE names a file,
+each traced call of an operation's process() is written to it
+as a trace event: a span with the op's name, the rect, the thread,
+and the bytes the op allocated for its working buffers.
+The file is shared by all bootchk ops in the process,
+so the spans of canny's interior nodes show on one timeline,
+per thread: where GEGL runs ops in parallel, and where one op waits on another.
+
+A span also audits the input of the op: whether GEGL converts it by babl,
+from the format of the node upstream to the format the op declared
+(inferred from the formats negotiated, as GEGL decides to convert, not counted inside babl),
+and an estimate of how long babl takes to convert as many pixels,
+by the cost per pixel of the pair of formats, timed once per process.
+Between the stages of canny, the count should be zero, see gradient-format.h.
+
+When BOOTCHK_TRACE is not set, a span reads no clock, and only tests:
+op_trace_begin, that the environment was looked at (once per module) and the tracer,
+op_trace_bytes and op_trace_end, trace->active.
+
+All functions accept a trace that is not active, and do nothing.
+*/
+typedef struct
+{
+  GeglOperation *operation;
+  GeglRectangle  rect;
+  gint64         start;       // microseconds, monotonic
+  gsize          bytes;       // allocated by the op, during the span
+  gboolean       active;      // tracing is enabled
+  const Babl    *from;        // format of the input upstream, when converted, else NULL
+  const Babl    *to;          // format of the input the op declared
+  gint64         convert_us;  // to convert the input, estimated
+} OpTrace;
+
+void op_trace_begin (OpTrace             *trace,
+                     GeglOperation       *operation,
+                     const GeglRectangle *rect);
+
+void op_trace_bytes (OpTrace             *trace,
+                     gsize                bytes);
+
+void op_trace_end   (OpTrace             *trace);
@@ -0,0 +1,82 @@
+/*
+The formats of point ops on the kernels of bootchk-point.h.
+Include after bootchk-kernels.h.
+
+A point op runs on the format of its source, when the kernels have a loop for it:
+GEGL then passes the source's buffer without a babl conversion,
+e.g. canny's half floats stay half, GIMP's 8 bit layer stays u8,
+and the op reads and writes the fewest bytes the graph gives it.
+Only of gray or component formats: of a color, the op takes Y'A of its type.
+*/
+
+/* The BootchkType of the components of format, or -1 when none, or format is NULL. */
+static inline gint
+bootchk_point_type (const Babl *format)
+{
+  static const gchar *const names[BOOTCHK_N_TYPES] = { "float", "half", "u16", "u8" };
+  const gchar              *name;
+  gint                      type;
+
+  if (format == NULL)
+    return -1;
+
+  name = babl_get_name (babl_format_get_type (format, 0));
+
+  for (type = 0; type < BOOTCHK_N_TYPES; type++)
+    if (g_strcmp0 (name, names[type]) == 0)
+      return type;
+
+  return -1;
+}
+
+/*
+Is format nonlinear gray, or of components: a kernel thresholds its first channel,
+so that must be the luminance Y' the thresholds are of, or a magnitude,
+not the red of a color, nor linear Y, which babl converts to Y'.
+*/
+static inline gboolean
+bootchk_point_is_gray (const Babl *format)
+{
+  static const gchar *const models[] = { "Y'", "Y'A" };
+  const gchar              *model;
+  guint                     i;
+
+  if (babl_format_is_format_n (format))
+    return TRUE;
+
+  model = babl_get_name (babl_format_get_model (format));
+
+  for (i = 0; i < G_N_ELEMENTS (models); i++)
+    if (g_strcmp0 (model, models[i]) == 0)
+      return TRUE;
+
+  return FALSE;
+}
+
+/*
+Source, when nonlinear gray or of components, of a type and 1, 2, or 4 channels the kernels have.
+Else Y'A in space, of the source's type (float when the kernels have no loop of it):
+babl converts a color, or linear gray, to Y', as the op did before it took the source's format.
+Fallback when there is no source.
+*/
+static inline const Babl *
+bootchk_point_format (const Babl *source,
+                      const Babl *space,
+                      const Babl *fallback)
+{
+  static const gchar *const names[BOOTCHK_N_TYPES] = { "Y'A float", "Y'A half", "Y'A u16", "Y'A u8" };
+  gint                      type;
+  gint                      n_components;
+
+  if (source == NULL)
+    return fallback;
+
+  type         = bootchk_point_type (source);
+  n_components = babl_format_get_n_components (source);
+
+  if (type >= 0 && (n_components == 1 || n_components == 2 || n_components == 4) &&
+      bootchk_point_is_gray (source))
+    return source;
+
+  return babl_format_with_space (names[type >= 0 ? type : BOOTCHK_FLOAT], space);
+}
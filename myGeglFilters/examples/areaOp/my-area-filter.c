@@ -17,7 +17,12 @@
 #include "gegl-op.h"
 
 
-#define BPP 2 // Bytes per pixel for the input format (Y'A float has 2 channels)
+#include "op-progress.h"
+#include "op-trace.h"
+#include "area-filter.h"
+
+
+#define FPP 2 // Floats per pixel for the input format (Y'A float has 2 channels)
 
 
 
@@ -42,7 +47,7 @@ typedef enum
 
 
 static DirectionAxis
-clamped_gradient_axis (gfloat *gradient)
+clamped_gradient_axis (const gfloat *gradient)
 {
   gfloat angle = gradient[1]; // Assuming the second channel is the angle.
   
@@ -75,9 +80,9 @@ having two channels: magnitude and direction.
 */
 static gboolean
 is_gradient_magnitude_a_local_maximum(
-  gfloat *top_left,    gfloat *top,    gfloat *top_right,
-  gfloat *left,        gfloat *center, gfloat *right,
-  gfloat *bottom_left, gfloat *bottom, gfloat *bottom_right
+  const gfloat *top_left,    const gfloat *top,    const gfloat *top_right,
+  const gfloat *left,        const gfloat *center, const gfloat *right,
+  const gfloat *bottom_left, const gfloat *bottom, const gfloat *bottom_right
 )
 {
   gboolean result = FALSE;
@@ -109,122 +114,46 @@ is_gradient_magnitude_a_local_maximum(
   return result;
 }
 
+/*
+The filter of one row, as area_filter_process calls it, see common/area-filter.h.
+
+Rows are the row above, the row, and the row below, each pointing at x = 0,
+padded by a pixel on each side (by the abyss, clamped),
+so every pixel has all its neighbors, no clamping of pointers here.
+Copying this template, write the filter of a row like this,
+and the streaming, the borders, and the memory are done for you.
+*/
 static void
-non_maximum_suppression
- (GeglBuffer          *src,
-  const GeglRectangle *src_rect,
-  GeglBuffer          *dst,
-  const GeglRectangle *dst_rect,
-  const Babl          *format)
+non_maximum_suppression_row (void               *data,
+                             const float *const *rows,
+                             float              *out,
+                             int                 width)
 {
-  gint x,y;
-  gint dest_index = 0;
-  gfloat *src_buf;
-  gfloat *after_src_buf;
-  gfloat *dst_buf;
-
-  src_buf = g_new0 (gfloat, src_rect->width * src_rect->height * BPP);
-  dst_buf = g_new0 (gfloat, dst_rect->width * dst_rect->height * BPP);
-
-  gegl_buffer_get (src, src_rect, 1.0, format,
-                   src_buf, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
-
-  after_src_buf = src_buf + src_rect->width * src_rect->height * BPP;
-
-  /*
-  Raster scan the source rectangle.
-  */
-  for (y = 0; y < dst_rect->height; y++)
-    for (x = 0; x < dst_rect->width; x++)
-      {
-        gfloat *row_start, *row_next;
-        
-        /* Pointers to neighbors. */
-        gfloat *top_left,    *top,     *top_right;
-        gfloat *left,        *center,  *right;
-        gfloat *bottom_left, *bottom,  *bottom_right;
-
-        row_start = src_buf + y * src_rect->width * BPP;
-        row_next = row_start + src_rect->width * BPP;
-
-        /* 
-        Compute pointers to neighbor pixels.
-        Using address arithmetic.
-        Clamping pointers into the buf.
-        */
-        /* Unclamped pointers to neighbor pixels. */
-      
-        center       = row_start + x * BPP;
-        left         = center - BPP;
-        right        = center + BPP;
-
-        top          = center - src_rect->width * BPP;
-        top_left     = top - BPP;
-        top_right    = top + BPP;
-        
-        bottom       = center + src_rect->width * BPP;
-        bottom_left  = bottom - BPP;
-        bottom_right = bottom + BPP;
-
-        /* 
-        When pointers to neighbors are out of source rect bounds,
-        clamp them into the rect.
-        */
-        if (top < src_buf)
-          {
-            top_left  += src_rect->width * BPP;
-            top       += src_rect->width * BPP;
-            top_right += src_rect->width * BPP;
-          }
-        else if (bottom >= after_src_buf)
-          {
-            bottom_left  -= src_rect->width * BPP;
-            bottom       -= src_rect->width * BPP;
-            bottom_right -= src_rect->width * BPP;
-          }
-
-        if (left < row_start)
-          {
-            top_left    += BPP;
-            left        += BPP;
-            bottom_left += BPP;
-          }
-        else if (right >= row_next)
-          {
-            top_right    -= BPP;
-            right        -= BPP;
-            bottom_right -= BPP;
-          }
-
-        /*
-        Perform the filtering, to the output buffer.
-        When center is local maximum, 
-        keep magnitude component,
-        else discard (set to zero).
-        */
-        if (is_gradient_magnitude_a_local_maximum(
-          top_left, top, top_right,
-          left, center, right,
-          bottom_left, bottom, bottom_right))
-          {
-            // keep its magnitude component.
-            dst_buf[dest_index] = center[0];
-          } 
-        else 
-          {
-            dst_buf[dest_index] = 0;
-          }
-
-        // Keep direction component, unchanged.
-        dst_buf[dest_index + 1] = center[1];
-
-        dest_index++;
-      }
-
-  gegl_buffer_set (dst, dst_rect, 0, format, dst_buf,
-                   GEGL_AUTO_ROWSTRIDE);
-  g_free (src_buf);
-  g_free (dst_buf);
+  const gfloat *top    = rows[0];
+  const gfloat *mid    = rows[1];
+  const gfloat *bottom = rows[2];
+  gint          x;
+
+  for (x = 0; x < width; x++)
+    {
+      const gfloat *center = mid + x * FPP;
+
+      /*
+      When center is local maximum,
+      keep magnitude component,
+      else discard (set to zero).
+      */
+      if (is_gradient_magnitude_a_local_maximum(
+            top + (x - 1) * FPP,    top + x * FPP,    top + (x + 1) * FPP,
+            center - FPP,           center,           center + FPP,
+            bottom + (x - 1) * FPP, bottom + x * FPP, bottom + (x + 1) * FPP))
+        out[x * FPP] = center[0];
+      else
+        out[x * FPP] = 0;
+
+      // Keep direction component, unchanged.
+      out[x * FPP + 1] = center[1];
+    }
 }
 
 
@@ -244,7 +173,11 @@ static void prepare (GeglOperation *operation)
 }
 
 
-/* Has type of FilterClass.Process */
+/*
+Has type of FilterClass.Process
+
+Called per roi, from several threads at once: no state outside the stack.
+*/
 static gboolean
 process (GeglOperation       *operation,
          GeglBuffer          *input,
@@ -252,21 +185,24 @@ process (GeglOperation       *operation,
          const GeglRectangle *result,
          gint                 level)
 {
-  GeglRectangle compute;
-  
+  const Babl *format = gegl_operation_get_format (operation, "output");
+  OpProgress  progress;
+  OpTrace     trace;
+  gboolean    completed;
 
-  compute = gegl_operation_get_required_for_output (operation, "input", result);
-  //has_alpha = babl_format_has_alpha (gegl_operation_get_format (operation, "output"));
-  
-  non_maximum_suppression (
-    input,
-    &compute, 
-    output, 
-    result,
-    babl_format_with_space ("RGBA float",
-    gegl_operation_get_format (operation, "output")));
-
-  return TRUE;
+  op_trace_begin (&trace, operation, result);
+  op_progress_begin (&progress, operation, result);
+
+  op_trace_bytes (&trace, area_filter_process (operation, input, output, result,
+                                               format, format,
+                                               non_maximum_suppression_row, NULL,
+                                               &progress));
+
+  completed = op_progress_end (&progress);
+  op_trace_end (&trace);
+
+  // Partial when cancelled, not the result, see op-progress.h.
+  return completed;
 }
 
 static void
@@ -292,7 +228,7 @@ gegl_op_class_init (GeglOpClass *klass)
 
   // Set the operation class attributes/properties.
   operation_class->opencl_support = FALSE;
-  operation_class->threaded       = FALSE;
+  operation_class->threaded       = TRUE;
 
   gegl_operation_class_set_keys (operation_class,
     "title",       "A Area filter",
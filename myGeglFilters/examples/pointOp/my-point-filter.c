@@ -23,17 +23,51 @@ property_double (high_threshold, "High Threshold", 0.66)
 // Base on the above definitions, gegl-op.h generates code for the operation
 #include "gegl-op.h"
 
+#include "bootchk-kernels.h"
+#include "bootchk-point.h"
+#include "op-trace.h"
+#include "point-format.h"
 
+
+/*
+Y'A of the type of the source, the narrowest the graph gives:
+an 8 bit image is thresholded in u8, not converted to float and back.
+Any type the point kernels have, else float.
+*/
 static void prepare (GeglOperation *operation)
 {
-  const Babl *space = gegl_operation_get_source_space (operation, "input");
-  // TODO float 2 format is not defined in babl, so we use Y'A float.
-  gegl_operation_set_format (operation, "input",  babl_format_with_space ("Y'A float", space));
-  gegl_operation_set_format (operation, "output", babl_format_with_space ("Y'A float", space));
+  const Babl *space  = gegl_operation_get_source_space (operation, "input");
+  const Babl *source = gegl_operation_get_source_format (operation, "input");
+  const Babl *format = babl_format_with_space ("Y'A float", space);
+
+  if (bootchk_point_type (source) >= 0)
+    {
+      gchar *name = g_strdup_printf ("Y'A %s", babl_get_name (babl_format_get_type (source, 0)));
+
+      format = babl_format_with_space (name, space);
+      g_free (name);
+    }
+
+  gegl_operation_set_format (operation, "input",  format);
+  gegl_operation_set_format (operation, "output", format);
 }
 
 
-#define FPP 2 // Floats per pixel for the input format
+/*
+The transform of one pixel, on floats, whatever the format:
+bootchk-point.h generates the loops around it, for each type.
+Conditional expressions, not branches, so the loops vectorize.
+*/
+static inline void
+my_threshold_pixel (float *v, const void *params)
+{
+  const gfloat *thresholds = params;  // low, high
+  gfloat        c          = v[0];
+
+  v[0] = c < thresholds[0] ? 0.0f : (c > thresholds[1] ? 1.0f : c);
+}
+
+BOOTCHK_POINT_VARIANTS (my_threshold)
 
 
 /*
@@ -45,7 +79,7 @@ Transform function is
 
 Thresholds the first channel of each pixel in the input buffer.
 
-The input and output have two channels.
+The input and output have two channels, of any type of bootchk-point.h.
 
 A typical use case: first channel is luminance and the second is alpha (Y'A).
 Another use case is a gradient field, 
@@ -61,9 +95,8 @@ When the high threshold is less than or equal to the low threshold,
 the transform function is a simple step function 
 having a step at the low threshold.
 
-The input buffer is expected to be in the format Y'A float.
-The output buffer is also in the format Y'A float.
-The input and output buffers have two channels per pixel, hence the stride of 2.
+The input and output buffers are in the format Y'A, of the type of the source, see prepare.
+Integer types are normalized to [0, 1], as babl does, so the thresholds are the same.
 
 The operation processes each pixel independently, hence it is a point filter.
 Process each pixel in a single pass.
@@ -74,6 +107,9 @@ set to white (1.0) if above the high threshold, and otherwise keeps the original
 
 This is a simple thresholding operation that can be used for various effects,
 such as creating a binary mask or isolating certain brightness levels in an image.
+
+The loop is of my_threshold_pixel, for the type of the format,
+one of those BOOTCHK_POINT_VARIANTS generated above.
  */
 static gboolean
 process (GeglOperation       *op,
@@ -83,33 +119,17 @@ process (GeglOperation       *op,
          const GeglRectangle *roi,
          gint                 level)
 {
-  // Pointers to scan buffer.
-  gfloat *in = in_buf;
-  gfloat *out = out_buf;
-
   // Get low and high thresholds from the operation properties.
-  gfloat low_threshold  = GEGL_PROPERTIES (op)->low_threshold;
-  gfloat high_threshold = GEGL_PROPERTIES (op)->high_threshold;
-  
-  
-  for (glong i=0; i<n_pixels; i++)
-    {
-      gfloat c = in[0];
-  
-      if (c < low_threshold)
-        out[0] = 0; // Set to black when below low threshold
-      else if (c > high_threshold)
-        out[0] = 1; // Set to white when above high threshold
-      else  // Otherwise, keep original value
-        out[0] = in[0];
-          
-      // Copy second channel unchanged.
-      out[1] = in[1];
-
-      // Move to the next pixel.
-      in  += FPP;
-      out += FPP;
-    }
+  gfloat           thresholds[2] = { GEGL_PROPERTIES (op)->low_threshold,
+                                     GEGL_PROPERTIES (op)->high_threshold };
+  const Babl      *format        = gegl_operation_get_format (op, "input");
+  BootchkPointFunc loop          = bootchk_point_lookup (my_threshold_variants,
+                                                         bootchk_point_type (format), 2);
+  OpTrace          trace;
+
+  op_trace_begin (&trace, op, roi);
+  loop (in_buf, out_buf, n_pixels, thresholds);
+  op_trace_end (&trace);
 
   return TRUE;
 }
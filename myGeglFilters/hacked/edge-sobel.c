@@ -39,6 +39,8 @@ property_boolean (keep_sign,  "Keep Sign", TRUE)
 
 #include "gegl-op.h"
 #include <stdio.h> // TODO
+#include "bootchk-kernels.h"
+#include "op-trace.h"
 
 #define SOBEL_RADIUS 1
 
@@ -191,6 +193,7 @@ process (GeglOperation       *operation,
   gboolean keep_sign  = o->keep_sign;
   gboolean horizontal = o->horizontal;
   gboolean vertical   = o->vertical;
+  OpTrace  trace;
 
   compute = gegl_operation_get_required_for_output (operation, "input", result);
   has_alpha = babl_format_has_alpha (gegl_operation_get_format (operation, "output"));
@@ -208,21 +211,27 @@ process (GeglOperation       *operation,
   g_debug ("Destination Rectangle for edge_sobel: %d %d %d %d",
            result->x, result->y, result->width, result->height);  
 
+  op_trace_begin (&trace, operation, result);
+
   edge_sobel (input, &compute, output, result,
   // edge_sobel (input, result, output, result,
               // o->horizontal, o->vertical, o->keep_sign, has_alpha,
               horizontal, vertical, keep_sign, has_alpha,
               babl_format_with_space ("RGBA float",
               gegl_operation_get_format (operation, "output")));
-  return TRUE;
-}
 
-inline static gfloat
-magnitude(gfloat a, gfloat b)
-{
-  return sqrtf(a*a+b*b);
+  // The RGBA float copies of the source and result rects, see edge_sobel.
+  op_trace_bytes (&trace, ((gsize) compute.width * compute.height
+                           + (gsize) result->width * result->height) * 4 * sizeof (gfloat));
+  op_trace_end (&trace);
+
+  return TRUE;
 }
 
+/*
+Hacked: the Sobel loop is bootchk_sobel_rgba, in the kernels library,
+so it can be benchmarked apart from GEGL.
+*/
 static void
 edge_sobel (GeglBuffer          *src,
             const GeglRectangle *src_rect,
@@ -234,10 +243,7 @@ edge_sobel (GeglBuffer          *src,
             gboolean            has_alpha,
             const Babl         *format)
 {
-  gint x,y;
-  gint offset;
   gfloat *src_buf;
-  gfloat *after_src_buf;
   gfloat *dst_buf;
 
   src_buf = g_new0 (gfloat, src_rect->width * src_rect->height * 4);
@@ -246,142 +252,9 @@ edge_sobel (GeglBuffer          *src,
   gegl_buffer_get (src, src_rect, 1.0, format,
                    src_buf, GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
 
-  after_src_buf = src_buf + src_rect->width * src_rect->height * 4;
-
-  /* Apply the Sobel operator. Technically, the following is not Sobel
-     as it does not use pixel intensities, but works on the individual
-     RGB channels. But it is similar to the classic GIMP and PhotoShop
-     filter.
-
-     See paper "History and Definition of the Sobel Operator" by Irwin
-     Sobel that seems to be the only free and authentic description.
-  */
-  offset = 0;
-  for (y = 0; y < dst_rect->height; y++)
-    for (x = 0; x < dst_rect->width; x++)
-      {
-        gfloat hor_grad[3] = {0.0f, 0.0f, 0.0f};
-        gfloat ver_grad[3] = {0.0f, 0.0f, 0.0f};
-        gfloat gradient[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-        gfloat *row_start, *row_next;
-        gfloat *tl_px, *t_px, *tr_px;
-        gfloat *l_px, *center_px, *r_px;
-        gfloat *bl_px, *b_px, *br_px;
-        gint c;
-
-        row_start = src_buf + y * src_rect->width * 4;
-        row_next = row_start + src_rect->width * 4;
-
-        /* This pixel */
-        center_px = row_start + x * 4;
-        /* Top pixel */
-        t_px = center_px - src_rect->width * 4;
-        /* Top-left pixel */
-        tl_px = t_px - 4;
-        /* Top-right pixel */
-        tr_px = t_px + 4;
-        /* Left pixel */
-        l_px = center_px - 4;
-        /* Right pixel */
-        r_px = center_px + 4;
-        /* Bottom pixel */
-        b_px = center_px + src_rect->width * 4;
-        /* Bottom-left pixel */
-        bl_px = b_px - 4;
-        /* Bottom-right pixel */
-        br_px = b_px + 4;
-
-        /* If pixels around the center pixel are out of source rect
-           bounds, clamp them into the rect. */
-        if (t_px < src_buf)
-          {
-            tl_px += src_rect->width * 4;
-            t_px += src_rect->width * 4;
-            tr_px += src_rect->width * 4;
-          }
-        else if (b_px >= after_src_buf)
-          {
-            bl_px -= src_rect->width * 4;
-            b_px -= src_rect->width * 4;
-            br_px -= src_rect->width * 4;
-          }
-
-        if (l_px < row_start)
-          {
-            tl_px += 4;
-            l_px += 4;
-            bl_px += 4;
-          }
-        else if (r_px >= row_next)
-          {
-            tr_px -= 4;
-            r_px -= 4;
-            br_px -= 4;
-          }
-
-        if (horizontal)
-          {
-            /*
-             * Horizontal kernel:
-             *
-             *      [-1  0  +1]
-             * Gx = [-2  0  +2] * P
-             *      [-1  0  -1]
-             */
-            for (c = 0; c < 3; c++)
-              {
-                hor_grad[c] += (-1.0f * tl_px[c]) + (1.0f * tr_px[c]);
-                hor_grad[c] += (-2.0f * l_px[c]) + (2.0f * r_px[c]);
-                hor_grad[c] += (-1.0f * bl_px[c]) + (1.0f * br_px[c]);
-              }
-          }
-
-        if (vertical)
-          {
-            /*
-             * Vertical kernel:
-             *
-             *      [+1  +2  +1]
-             * Gy = [ 0   0   0] * P
-             *      [-1  -2  -1]
-             */
-            for (c = 0; c < 3; c++)
-              {
-                ver_grad[c] += (1.0f * tl_px[c]) + (2.0f * t_px[c]) + (1.0f * tr_px[c]);
-                ver_grad[c] += (-1.0f * bl_px[c]) + (-2.0f * b_px[c]) + (-1.0f * br_px[c]);
-              }
-          }
-
-        if (horizontal && vertical)
-          {
-             /* sqrt(32.0) = 5.656854 */
-            for (c = 0; c < 3; c++)
-              gradient[c] = magnitude (hor_grad[c], ver_grad[c]) / 5.656854f;
-          }
-        else
-          {
-            if (keep_sign)
-              {
-                for (c = 0; c < 3; c++)
-                  gradient[c] = 0.5f + (hor_grad[c] + ver_grad[c]) / 8.0f;
-              }
-            else
-              {
-                for (c = 0; c < 3; c++)
-                  gradient[c] = fabsf (hor_grad[c] + ver_grad[c]) / 4.0f;
-              }
-          }
-
-        if (has_alpha)
-          gradient[3] = center_px[3];
-        else
-          gradient[3] = 1.0f;
-
-        for (c = 0; c < 4; c++)
-          dst_buf[offset * 4 + c] = gradient[c];
-
-        offset++;
-      }
+  bootchk_sobel_rgba (src_buf, src_rect->width, src_rect->height, src_rect->width * 4,
+                      dst_buf, dst_rect->width, dst_rect->height, dst_rect->width * 4,
+                      horizontal, vertical, keep_sign, has_alpha);
 
   gegl_buffer_set (dst, dst_rect, 0, format, dst_buf,
                    GEGL_AUTO_ROWSTRIDE);
@@ -404,6 +277,9 @@ gegl_op_class_init (GeglOpClass *klass)
 
   filter_class->process           = process;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
     "name",        "bootchk:my-edge-sobel",
     "title",       "Sobel Edge Detection",
@@ -22,6 +22,7 @@
 
 #define GETTEXT_PACKAGE "gegl-0.4"
 #include <math.h>
+#include <string.h>
 
 #include <glib/gi18n-lib.h>
 
@@ -39,6 +40,24 @@ property_enum (output_mode, _("Output mode"),
                0)
   description (_("Output Mode"))
 
+/* Hacked: for consumers that only compare magnitudes. */
+property_boolean (squared, _("Squared magnitude"), FALSE)
+  description (_("Output the magnitude squared, without the square root. "
+                 "Non-max suppression and thresholds compare squares as well."))
+
+/* Hacked: half the bytes of the output buffer. */
+property_boolean (half, _("Half floats"), FALSE)
+  description (_("Output IEEE half floats, converted from the float results per strip."))
+
+/* Hacked: for cut-outs, large transparent margins. */
+property_boolean (skip_transparent, _("Skip transparent"), FALSE)
+  description (_("Output zero where the pixel and its neighbors are fully transparent, "
+                 "skipping strips that are all transparent."))
+
+property_boolean (premultiplied, _("Premultiplied"), FALSE)
+  description (_("The gradient of the color premultiplied by alpha, "
+                 "so the edge of the opaque region is an edge too."))
+
 
 #else
 
@@ -46,9 +65,10 @@ property_enum (output_mode, _("Output mode"),
 #define GEGL_OP_NAME         my_image_gradient
 #define GEGL_OP_C_SOURCE     image-gradient.c
 
-#define POW2(x) ((x)*(x))
-
 #include "gegl-op.h"
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-trace.h"
 
 static void
 prepare (GeglOperation *operation)
@@ -57,7 +77,8 @@ prepare (GeglOperation *operation)
   GeglOperationAreaFilter *area       = GEGL_OPERATION_AREA_FILTER (operation);
   GeglProperties          *o          = GEGL_PROPERTIES (operation);
   const Babl              *rgb_format = babl_format_with_space ("R'G'B' float", space);
-  const Babl              *out_format = babl_format_n (babl_type ("float"), 2);
+  const Babl              *out_format = o->half ? bootchk_gradient_half_format ()
+                                                : bootchk_gradient_format ();
 
   area->left   =
   area->top    =
@@ -67,9 +88,15 @@ prepare (GeglOperation *operation)
   if (o->output_mode == 0 ||
       o->output_mode == 1)
     {
-      out_format = babl_format_n (babl_type ("float"), 1);
+      out_format = babl_format_n (babl_type (o->half ? "half" : "float"), 1);
     }
 
+  // Alpha is read only when needed: otherwise a third less to convert and copy.
+  if (o->premultiplied)
+    rgb_format = babl_format_with_space ("R'aG'aB'aA float", space);
+  else if (o->skip_transparent)
+    rgb_format = babl_format_with_space ("R'G'B'A float", space);
+
   gegl_operation_set_format (operation, "input",  rgb_format);
   gegl_operation_set_format (operation, "output", out_format);
 }
@@ -89,6 +116,24 @@ get_bounding_box (GeglOperation *operation)
   return result;
 }
 
+/*
+Pixels per strip, a strip fits in the L2 cache.
+A wide roi gets strips of fewer rows, but always at least one.
+*/
+#define STRIP_PIXELS (32 * 1024)
+
+/*
+Hacked: processes the roi in strips of rows, not row by row.
+Per strip, one get of the rows and their border (clamped at the abyss),
+one deinterleave to planes, and one set of the result.
+When half, the result is converted to half floats before the set.
+
+When the input has alpha (skip_transparent or premultiplied), it is a fourth plane.
+When skip_transparent, a strip all transparent is set to zeros, no gradient computed,
+and in other strips the pixels whose neighborhood is all transparent are zeroed,
+so the result is the same however the roi is split.
+Premultiplied, the color of a transparent pixel is zero, so skipping is exact.
+*/
 static gboolean
 process (GeglOperation       *operation,
          GeglBuffer          *input,
@@ -96,119 +141,101 @@ process (GeglOperation       *operation,
          const GeglRectangle *roi,
          gint                 level)
 {
-  GeglProperties  *o          = GEGL_PROPERTIES (operation);
-  const Babl      *in_format  = gegl_operation_get_format (operation, "input");
-  const Babl      *out_format = gegl_operation_get_format (operation, "output");
-  gfloat *row1;
-  gfloat *row2;
-  gfloat *row3;
-  gfloat *row4;
-  gfloat *top_ptr;
-  gfloat *mid_ptr;
-  gfloat *down_ptr;
-  gfloat *tmp_ptr;
-  gint    x, y;
-  gint    n_components;
-
-  GeglRectangle row_rect;
-  GeglRectangle out_rect;
-
-  n_components = babl_format_get_n_components (out_format);
-  row1 = g_new (gfloat, (roi->width + 2) * 3);
-  row2 = g_new (gfloat, (roi->width + 2) * 3);
-  row3 = g_new (gfloat, (roi->width + 2) * 3);
-  row4 = g_new0 (gfloat, roi->width * n_components);
-
-  top_ptr  = row1;
-  mid_ptr  = row2;
-  down_ptr = row3;
-
-  row_rect.width = roi->width + 2;
-  row_rect.height = 1;
-  row_rect.x = roi->x - 1;
-  row_rect.y = roi->y - 1;
-
-  out_rect.x      = roi->x;
-  out_rect.width  = roi->width;
-  out_rect.height = 1;
-
-  gegl_buffer_get (input, &row_rect, 1.0, in_format, top_ptr,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
-
-  row_rect.y++;
-  gegl_buffer_get (input, &row_rect, 1.0, in_format, mid_ptr,
-                   GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP); 
-
-  for (y = roi->y; y < roi->y + roi->height; y++)
+  GeglProperties  *o            = GEGL_PROPERTIES (operation);
+  const Babl      *in_format    = gegl_operation_get_format (operation, "input");
+  const Babl      *out_format   = gegl_operation_get_format (operation, "output");
+  gint             n_components = babl_format_get_n_components (out_format);
+  gint             in_width     = roi->width + 2;
+  gint             strip_height = MAX (1, STRIP_PIXELS / in_width);
+  gint             n_channels   = babl_format_get_n_components (in_format);
+  gsize            in_size;
+  gfloat          *rgb;     // a strip and its border, interleaved
+  gfloat          *planes;  // the same, one plane per channel, alpha last when read
+  gfloat          *out;
+  guint16         *out_half = NULL;  // the same, converted, when half
+  gsize            out_size;
+  gint             y;
+  OpTrace          trace;
+
+  op_trace_begin (&trace, operation, roi);
+
+  strip_height = MIN (strip_height, roi->height);
+  in_size      = (gsize) in_width * (strip_height + 2);
+  out_size     = (gsize) roi->width * strip_height * n_components;
+
+  rgb    = g_new  (gfloat, in_size * n_channels);
+  planes = g_new  (gfloat, in_size * n_channels);
+  out    = g_new0 (gfloat, out_size);
+  op_trace_bytes (&trace, (in_size * 2 * n_channels + out_size) * sizeof (gfloat));
+
+  if (o->half)
     {
-      row_rect.y = y + 1;
-      out_rect.y = y;
+      out_half = g_new (guint16, out_size);
+      op_trace_bytes (&trace, out_size * sizeof (guint16));
+    }
 
-      gegl_buffer_get (input, &row_rect, 1.0, in_format, down_ptr,
+  for (y = roi->y; y < roi->y + roi->height; y += strip_height)
+    {
+      GeglRectangle out_rect = { roi->x, y, roi->width,
+                                 MIN (strip_height, roi->y + roi->height - y) };
+      GeglRectangle in_rect  = { roi->x - 1, y - 1, in_width, out_rect.height + 2 };
+      gsize         n        = (gsize) in_rect.width * in_rect.height;
+      const gfloat *alpha    = planes + 3 * in_size;
+      gsize         not_transparent = n;
+      gint          row;
+
+      gegl_buffer_get (input, &in_rect, 1.0, in_format, rgb,
                        GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_CLAMP);
 
-      for (x = 1; x < row_rect.width - 1; x++)
-        {
-          gfloat dx[3];
-          gfloat dy[3];
-          gfloat magnitude[3];
-          gint   max_index;
-
-          dx[0] = (mid_ptr[(x-1) * 3] - mid_ptr[(x+1) * 3]);
-          dy[0] = (top_ptr[x*3] - down_ptr[x*3]);
-          magnitude[0] = sqrtf(POW2(dx[0]) + POW2(dy[0]));
-
-          dx[1] = (mid_ptr[(x-1) * 3 + 1] - mid_ptr[(x+1) * 3 + 1]);
-          dy[1] = (top_ptr[x*3 + 1] - down_ptr[x*3 + 1]);
-          magnitude[1] = sqrtf(POW2(dx[1]) + POW2(dy[1]));
+      if (n_channels == 4)
+        not_transparent = bootchk_deinterleave_rgba (rgb, planes, planes + in_size, planes + 2 * in_size,
+                                                     planes + 3 * in_size, n);
+      else
+        bootchk_deinterleave_rgb (rgb, planes, planes + in_size, planes + 2 * in_size, n);
 
-          dx[2] = (mid_ptr[(x-1) * 3 + 2] - mid_ptr[(x+1) * 3 + 2]);
-          dy[2] = (top_ptr[x*3 + 2] - down_ptr[x*3 + 2]);
-          magnitude[2] = sqrtf(POW2(dx[2]) + POW2(dy[2]));
-
-          if (magnitude[0] > magnitude[1])
-            max_index = 0;
-          else
-            max_index = 1;
-
-          if (magnitude[2] > magnitude[max_index])
-            max_index = 2;
-
-          if (o->output_mode == 0)
+      if (o->skip_transparent && not_transparent == 0)
+        {
+          // All transparent: the result is zeros, no gradient to compute.
+          memset (out, 0, (gsize) out_rect.width * out_rect.height * n_components * sizeof (gfloat));
+        }
+      else
+        {
+          for (row = 0; row < out_rect.height; row++)
             {
-              row4[(x-1) * n_components] = magnitude[max_index];
+              // Planes of the rows above, at, and below, from the first pixel inside the border.
+              gsize         offset  = (gsize) row * in_width + 1;
+              const gfloat *top[3]  = { planes + offset,
+                                        planes + in_size + offset,
+                                        planes + 2 * in_size + offset };
+              const gfloat *mid[3]  = { top[0] + in_width, top[1] + in_width, top[2] + in_width };
+              const gfloat *down[3] = { mid[0] + in_width, mid[1] + in_width, mid[2] + in_width };
+              gfloat       *out_row = out + (gsize) row * roi->width * n_components;
+
+              bootchk_gradient_row_planar (top, mid, down, out_row,
+                                           roi->width, o->output_mode, o->squared);
+
+              if (o->skip_transparent && not_transparent < n)
+                bootchk_clear_transparent (alpha + offset,
+                                           alpha + offset + in_width,
+                                           alpha + offset + 2 * in_width,
+                                           out_row, roi->width, n_components);
             }
-          else
-           {
-              // gfloat direction = atan2 (dy[max_index], dx[max_index]);
-              gfloat direction = atan2 (dx[max_index], dy[max_index]); 
-          
-              if (o->output_mode == 1)
-                {
-                  row4[(x-1) * n_components] = direction;
-                }
-              else
-                {
-                  // g_debug ("%s direction = %f", G_STRFUNC, direction);
-                  row4[(x-1) * n_components] = magnitude[max_index];
-                  row4[(x-1) * n_components + 1] = direction;
-                }
-           }
         }
 
-      gegl_buffer_set (output, &out_rect, level, out_format, row4,
-                       GEGL_AUTO_ROWSTRIDE);
+      if (o->half)
+        bootchk_float_to_half (out, out_half, (gsize) out_rect.width * out_rect.height * n_components);
 
-      tmp_ptr = top_ptr;
-      top_ptr = mid_ptr;
-      mid_ptr = down_ptr;
-      down_ptr = tmp_ptr;
+      gegl_buffer_set (output, &out_rect, level, out_format,
+                       o->half ? (gpointer) out_half : (gpointer) out,
+                       GEGL_AUTO_ROWSTRIDE);
     }
 
-  g_free (row1);
-  g_free (row2);
-  g_free (row3);
-  g_free (row4);
+  g_free (rgb);
+  g_free (planes);
+  g_free (out);
+  g_free (out_half);
+
+  op_trace_end (&trace);
 
   return TRUE;
 }
@@ -227,6 +254,9 @@ gegl_op_class_init (GeglOpClass *klass)
   operation_class->get_bounding_box = get_bounding_box;
   operation_class->opencl_support   = FALSE;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
     "name",        "bootchk:my-image-gradient",
     "title",       _("Image Gradient"),
@@ -0,0 +1,79 @@
+#include "bootchk-kernels.h"
+
+
+
+
+/* Rows of the ring: a strip, and the halo above and below it. */
+static int
+ring_rows (const BootchkAreaStrips *strips)
+{
+  return strips->strip_rows + 2 * strips->radius;
+}
+
+/* Floats per input row, with its padding. */
+static size_t
+ring_stride (const BootchkAreaStrips *strips)
+{
+  return (size_t) (strips->width + 2 * strips->radius) * strips->in_components;
+}
+
+
+size_t
+bootchk_area_scratch_floats (const BootchkAreaStrips *strips)
+{
+  return ring_rows (strips) * ring_stride (strips)
+         + (size_t) strips->strip_rows * strips->width * strips->out_components;
+}
+
+int
+bootchk_area_run (const BootchkAreaStrips *strips,
+                  float                   *scratch)
+{
+  const int    radius  = strips->radius;
+  const int    n_ring  = ring_rows (strips);
+  const size_t stride  = ring_stride (strips);
+  float       *ring    = scratch;
+  float       *out     = scratch + n_ring * stride;
+  int          fetched = -radius;  // the next input row to fetch
+  int          next    = 0;        // its row in the ring
+  int          y0;
+
+  for (y0 = 0; y0 < strips->height; y0 += strips->strip_rows)
+    {
+      int n    = strips->height - y0 < strips->strip_rows ? strips->height - y0 : strips->strip_rows;
+      int last = y0 + n - 1 + radius;  // the last input row of the strip's halo
+      int i;
+
+      /*
+      Fetch up to the end of the ring, then from its start.
+      The rows overwritten are above the halo of this strip, done with.
+      */
+      while (fetched <= last)
+        {
+          int k = last - fetched + 1 < n_ring - next ? last - fetched + 1 : n_ring - next;
+
+          strips->fetch (strips->data, fetched, k, ring + next * stride);
+          fetched += k;
+          next     = (next + k) % n_ring;
+        }
+
+      for (i = 0; i < n; i++)
+        {
+          const float *rows[2 * BOOTCHK_AREA_MAX_RADIUS + 1];
+          int          j;
+
+          // Input row y - radius + j is in ring row (y + j) % n_ring, row -radius in ring row 0.
+          for (j = 0; j <= 2 * radius; j++)
+            rows[j] = ring + ((y0 + i + j) % n_ring) * stride + radius * strips->in_components;
+
+          strips->filter (strips->filter_data, rows,
+                          out + (size_t) i * strips->width * strips->out_components,
+                          strips->width);
+        }
+
+      if (strips->store (strips->data, y0, n, out))
+        return 1;
+    }
+
+  return 0;
+}
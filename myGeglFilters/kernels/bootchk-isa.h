@@ -0,0 +1,90 @@
+/*
+The kernels dispatched by CPU, private to the kernels library.
+
+The files of these kernels are compiled once per variant (see meson.build):
+base (SSE2 on x86-64, or whatever the target's baseline is), AVX2, and AVX-512,
+each with BOOTCHK_ISA defined to its name.
+Included first, before bootchk-kernels.h, this renames each kernel to name_isa,
+so the variants link into one library side by side.
+dispatch.c defines the kernels by their own names, calling the variant selected,
+see bootchk_kernels_init.
+
+Every external function of those files must be in BOOTCHK_ISA_KERNELS,
+else the variants define it twice.
+X (type, return, name, parameters, arguments), return empty when type is void.
+*/
+#define BOOTCHK_ISA_KERNELS(X)                                                              \
+  X (void,   ,       bootchk_nms_span,                                                      \
+     (const float *top, const float *mid, const float *bottom, float *out, int n,           \
+      int squared),                                                                         \
+     (top, mid, bottom, out, n, squared))                                                   \
+  X (int,    return, bootchk_is_black,                                                      \
+     (const float *in, size_t n),                                                           \
+     (in, n))                                                                               \
+  X (void,   ,       bootchk_hyst_states_of_row,                                            \
+     (const float *in, int pixel_stride, uint8_t *states, int n),                           \
+     (in, pixel_stride, states, n))                                                         \
+  X (void,   ,       bootchk_hyst_write_row,                                                \
+     (const float *in, const uint8_t *states, float *out, int n, int remove_weak,           \
+      BootchkHystCounts *counts),                                                           \
+     (in, states, out, n, remove_weak, counts))                                             \
+  X (size_t, return, bootchk_hyst_brushfire,                                                \
+     (uint8_t *states, int width, int height, ptrdiff_t stride),                            \
+     (states, width, height, stride))                                                       \
+  X (BootchkPointFunc, return, bootchk_threshold_point,                                     \
+     (BootchkType type, int channels, int squared),                                         \
+     (type, channels, squared))                                                             \
+  X (void,   ,       bootchk_double_threshold,                                              \
+     (const float *in, float *out, long n, float low, float high),                          \
+     (in, out, n, low, high))                                                               \
+  X (void,   ,       bootchk_double_threshold_squared,                                      \
+     (const float *in, float *out, long n, float low, float high),                          \
+     (in, out, n, low, high))                                                               \
+  X (void,   ,       bootchk_squared_threshold,                                             \
+     (float low, float high, float *low_squared, float *high_squared),                      \
+     (low, high, low_squared, high_squared))                                                \
+  X (void,   ,       bootchk_sobel_rgba,                                                    \
+     (const float *src, int src_width, int src_height, ptrdiff_t src_stride,                \
+      float *dst, int dst_width, int dst_height, ptrdiff_t dst_stride,                      \
+      int horizontal, int vertical, int keep_sign, int has_alpha),                          \
+     (src, src_width, src_height, src_stride, dst, dst_width, dst_height, dst_stride,       \
+      horizontal, vertical, keep_sign, has_alpha))                                          \
+  X (void,   ,       bootchk_gradient_row_planar,                                           \
+     (const float *const top[3], const float *const mid[3], const float *const down[3],     \
+      float *out, int n, BootchkGradientOutput output, int squared),                        \
+     (top, mid, down, out, n, output, squared))                                             \
+  X (void,   ,       bootchk_deinterleave_rgb,                                              \
+     (const float *rgb, float *r, float *g, float *b, size_t n),                            \
+     (rgb, r, g, b, n))                                                                     \
+  X (size_t, return, bootchk_deinterleave_rgba,                                             \
+     (const float *rgba, float *r, float *g, float *b, float *a, size_t n),                 \
+     (rgba, r, g, b, a, n))                                                                 \
+  X (void,   ,       bootchk_clear_transparent,                                             \
+     (const float *top, const float *mid, const float *down, float *out, int n,             \
+      int n_components),                                                                    \
+     (top, mid, down, out, n, n_components))                                                \
+  X (void,   ,       bootchk_false_color,                                                   \
+     (const float *in, float *out, size_t n, float emphasis),                               \
+     (in, out, n, emphasis))
+
+
+#define BOOTCHK_ISA_CONCAT(name, isa) name##_##isa
+#define BOOTCHK_ISA_NAME(name, isa)   BOOTCHK_ISA_CONCAT (name, isa)
+
+#ifdef BOOTCHK_ISA
+#define bootchk_nms_span                 BOOTCHK_ISA_NAME (bootchk_nms_span,                 BOOTCHK_ISA)
+#define bootchk_is_black                 BOOTCHK_ISA_NAME (bootchk_is_black,                 BOOTCHK_ISA)
+#define bootchk_hyst_states_of_row       BOOTCHK_ISA_NAME (bootchk_hyst_states_of_row,       BOOTCHK_ISA)
+#define bootchk_hyst_write_row           BOOTCHK_ISA_NAME (bootchk_hyst_write_row,           BOOTCHK_ISA)
+#define bootchk_hyst_brushfire           BOOTCHK_ISA_NAME (bootchk_hyst_brushfire,           BOOTCHK_ISA)
+#define bootchk_threshold_point          BOOTCHK_ISA_NAME (bootchk_threshold_point,          BOOTCHK_ISA)
+#define bootchk_double_threshold         BOOTCHK_ISA_NAME (bootchk_double_threshold,         BOOTCHK_ISA)
+#define bootchk_double_threshold_squared BOOTCHK_ISA_NAME (bootchk_double_threshold_squared, BOOTCHK_ISA)
+#define bootchk_squared_threshold        BOOTCHK_ISA_NAME (bootchk_squared_threshold,        BOOTCHK_ISA)
+#define bootchk_sobel_rgba               BOOTCHK_ISA_NAME (bootchk_sobel_rgba,               BOOTCHK_ISA)
+#define bootchk_gradient_row_planar      BOOTCHK_ISA_NAME (bootchk_gradient_row_planar,      BOOTCHK_ISA)
+#define bootchk_deinterleave_rgb         BOOTCHK_ISA_NAME (bootchk_deinterleave_rgb,         BOOTCHK_ISA)
+#define bootchk_deinterleave_rgba        BOOTCHK_ISA_NAME (bootchk_deinterleave_rgba,        BOOTCHK_ISA)
+#define bootchk_clear_transparent        BOOTCHK_ISA_NAME (bootchk_clear_transparent,        BOOTCHK_ISA)
+#define bootchk_false_color              BOOTCHK_ISA_NAME (bootchk_false_color,              BOOTCHK_ISA)
+#endif
@@ -0,0 +1,421 @@
+
+
+
+/*
+The inner loops of the bootchk filters, on plain arrays.
+
+Independent of GEGL, babl, and glib: C99 and libm only.
+The GEGL ops get and set their buffers, chunk by chunk,
+and hand the chunks to these kernels.
+So the kernels can be benchmarked, tested, and optimized in isolation,
+see bench/bootchk-bench.c.
+
+Arrays are of float, or of uint8_t for hysteresis states,
+or of uint16_t for IEEE half floats, converted to float for the other kernels.
+Pixels are interleaved channels.
+A stride is the distance between rows, in elements (not bytes.)
+*/
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+The kernels are compiled in variants for the SIMD of the CPU, see bootchk-isa.h:
+avx512 (F, BW, VL, DQ), avx2 (with FMA), and the base of the target, sse2 on x86-64.
+Init selects the best the CPU has, once, by cpuid: ops call it in gegl_op_class_init,
+else the first kernel called does.
+The environment variable BOOTCHK_CPU, one of those names, forces a variant,
+to benchmark or test it; one the CPU lacks is refused, with a message.
+The variants give the same results: floats are not contracted into FMAs.
+*/
+void        bootchk_kernels_init (void);
+
+/* The name of the variant selected. */
+const char *bootchk_kernels_isa  (void);
+
+
+/*
+Non-max suppression of a gradient field, two channels: magnitude and direction.
+
+Suppress a span of n pixels in one row.
+Top, mid, and bottom point to the first pixel of the span
+in the row above, the row itself, and the row below.
+The pixel before and the pixel after the span must be readable in each row.
+
+Out receives n pixels: the magnitude when a local maximum, else zero,
+and the direction unchanged.
+
+When squared, the magnitudes are squared, and are output squared.
+The local maxima are exactly those of the magnitudes (their sqrtf),
+see is_greater_magnitude in nms-kernels.c.
+*/
+void bootchk_nms_span (const float *top,
+                       const float *mid,
+                       const float *bottom,
+                       float       *out,
+                       int          n,
+                       int          squared);
+
+typedef void (*BootchkNmsSpanFunc) (const float *top,
+                                    const float *mid,
+                                    const float *bottom,
+                                    float       *out,
+                                    int          n,
+                                    int          squared);
+
+/*
+bootchk_nms_span of the variant for the CPU, see bootchk_kernels_init,
+for a caller of many short spans, e.g. a pixel at a time on the borders of chunks,
+to resolve it once, not per call through the dispatch.
+*/
+BootchkNmsSpanFunc bootchk_nms_span_func (void);
+
+/*
+Are the magnitudes of n pixels of two channels all zero?
+Then their suppression is a copy: black stays black, the direction is unchanged.
+Stops at the first pixel not black.
+*/
+int  bootchk_is_black        (const float *in,
+                              size_t       n);
+
+
+/*
+Hysteresis states, one byte per pixel.
+
+BOOTCHK_HYST_WEAK:   a candidate for promotion, magnitude neither zero (black, no edge)
+                     nor exactly 1.0 (white, strong edge).
+BOOTCHK_HYST_STRONG: burns its neighbors, magnitude greater than 0.5.
+
+A pixel can be both: a weak pixel with magnitude in (0.5, 1.0)
+burns its neighbors but is itself only promoted by a neighbor.
+Promotion clears BOOTCHK_HYST_WEAK and sets BOOTCHK_HYST_STRONG.
+*/
+#define BOOTCHK_HYST_WEAK   0x01
+#define BOOTCHK_HYST_STRONG 0x02
+
+/* Is magnitude weak, as in the classification above. */
+#define bootchk_is_weak_magnitude(magnitude) \
+  ((magnitude) > 0.0 && (magnitude) != 1.0)
+
+static inline uint8_t
+bootchk_hyst_state_of_magnitude (float magnitude)
+{
+  return (bootchk_is_weak_magnitude (magnitude) ? BOOTCHK_HYST_WEAK   : 0) |
+         (magnitude > 0.5                       ? BOOTCHK_HYST_STRONG : 0);
+}
+
+/* States of n pixels of the magnitude channel, pixels pixel_stride floats apart. */
+void   bootchk_hyst_states_of_row (const float *in,
+                                   int          pixel_stride,
+                                   uint8_t     *states,
+                                   int          n);
+
+/*
+Counts of pixels by final state:
+none (black), weak (not promoted), strong (white, or promoted.)
+*/
+typedef struct
+{
+  size_t none;
+  size_t weak;
+  size_t strong;
+} BootchkHystCounts;
+
+/*
+Output n pixels of two channels:
+white where the pixel was weak and its state is no longer, i.e. promoted,
+else the magnitude of in. The direction channel copied from in.
+
+When remove_weak, the output is binary instead:
+white where the final state is strong, else black.
+
+Adds the final states of the pixels to counts, unless NULL.
+*/
+void   bootchk_hyst_write_row     (const float       *in,
+                                   const uint8_t     *states,
+                                   float             *out,
+                                   int                n,
+                                   int                remove_weak,
+                                   BootchkHystCounts *counts);
+
+/*
+One pass of the brushfire over a plane of states.
+Promotes weak pixels having a strong 8-connected neighbor.
+On the edges of the plane, neighbors are clamped into the plane.
+Returns the count of pixels promoted, zero when the fire is out.
+*/
+size_t bootchk_hyst_brushfire     (uint8_t  *states,
+                                   int       width,
+                                   int       height,
+                                   ptrdiff_t stride);
+
+
+/*
+Point kernels, generated for each storage type and count of channels, see bootchk-point.h.
+Storage types of the components of a pixel, as the babl types of the same names.
+*/
+typedef enum
+{
+  BOOTCHK_FLOAT = 0,
+  BOOTCHK_HALF,
+  BOOTCHK_U16,
+  BOOTCHK_U8,
+  BOOTCHK_N_TYPES
+} BootchkType;
+
+/*
+A loop of a point kernel over n pixels.
+In and out may be the same array, when the channels in and out are as many.
+*/
+typedef void (*BootchkPointFunc) (const void *in,
+                                  void       *out,
+                                  size_t      n,
+                                  const void *params);
+
+/* The parameters of the threshold loops. */
+typedef struct
+{
+  float low;
+  float high;
+} BootchkThresholdParams;
+
+/*
+The loop of the double threshold below, of the first of channels (1, 2, or 4) of type,
+the others copied. Of squared magnitudes when squared. NULL for other channel counts.
+Integer types are normalized as babl does, so the thresholds are the same for any type.
+*/
+BootchkPointFunc bootchk_threshold_point (BootchkType type,
+                                          int         channels,
+                                          int         squared);
+
+
+/*
+Double threshold of the first of two channels, n pixels.
+Below low to 0, above high to 1, else unchanged.
+The second channel copied.
+In and out may be the same array.
+*/
+void bootchk_double_threshold (const float *in,
+                               float       *out,
+                               long         n,
+                               float        low,
+                               float        high);
+
+/*
+Double threshold as above, of squared magnitudes, as from the gradient when squared.
+Low and high are the thresholds of bootchk_squared_threshold, not of the magnitudes.
+Between, out is the magnitude, the sqrtf, so the output is as if never squared.
+Without branches, so it vectorizes: the sqrtf of every pixel is an instruction of the SIMD.
+*/
+void bootchk_double_threshold_squared (const float *in,
+                                       float       *out,
+                                       long         n,
+                                       float        low,
+                                       float        high);
+
+/*
+The thresholds on squared magnitudes equivalent to low and high on magnitudes,
+exactly, for every float:
+
+  sqrtf (c) < low   iff  c < *low_squared
+  sqrtf (c) > high  iff  c > *high_squared
+
+Not simply low * low: the product rounds, and sqrtf rounds,
+so a square near the threshold could land on the wrong side.
+*/
+void bootchk_squared_threshold (float  low,
+                                float  high,
+                                float *low_squared,
+                                float *high_squared);
+
+
+/*
+Convert n IEEE half floats (as babl type "half") to floats, or back.
+To store the intermediates of canny at half the bytes, and compute in float:
+a chunk is converted into a float scratch that stays in cache.
+
+By F16C when the CPU has it (checked once), else by scalar bit manipulation.
+The same results either way: to half rounds to nearest even,
+overflows to infinity, and keeps subnormals.
+*/
+void bootchk_half_to_float (const uint16_t *in,
+                            float          *out,
+                            size_t          n);
+
+void bootchk_float_to_half (const float    *in,
+                            uint16_t       *out,
+                            size_t          n);
+
+
+/*
+Sobel of RGBA, as gegl:edge-sobel.
+
+Dst pixel x, y from the 3x3 neighborhood of src pixel x, y,
+neighbors clamped into src.
+The channels are filtered separately, alpha copied when has_alpha, else opaque.
+*/
+void bootchk_sobel_rgba (const float *src,
+                         int          src_width,
+                         int          src_height,
+                         ptrdiff_t    src_stride,
+                         float       *dst,
+                         int          dst_width,
+                         int          dst_height,
+                         ptrdiff_t    dst_stride,
+                         int          horizontal,
+                         int          vertical,
+                         int          keep_sign,
+                         int          has_alpha);
+
+
+/*
+Image gradient by central differences, of one row of RGB,
+as gegl:image-gradient: of the channel having the largest magnitude.
+
+The RGB is planar (SoA): one array per channel,
+so the loop over pixels vectorizes.
+Top, mid, and down are the three channel planes of three rows,
+each pointing to the first pixel of n.
+The pixel before and the pixel after must be readable in mid.
+Out is one or two floats per pixel, per output.
+When squared, the magnitude is squared, without the sqrtf.
+
+The direction is atan2 (dy, dx), by bootchk_fast_atan2.
+*/
+typedef enum
+{
+  BOOTCHK_GRADIENT_MAGNITUDE = 0,
+  BOOTCHK_GRADIENT_DIRECTION,
+  BOOTCHK_GRADIENT_BOTH
+} BootchkGradientOutput;
+
+void bootchk_gradient_row_planar (const float *const    top[3],
+                                  const float *const    mid[3],
+                                  const float *const    down[3],
+                                  float                *out,
+                                  int                   n,
+                                  BootchkGradientOutput output,
+                                  int                   squared);
+
+/* Split n pixels of interleaved RGB into three planes. */
+void bootchk_deinterleave_rgb (const float *rgb,
+                               float       *r,
+                               float       *g,
+                               float       *b,
+                               size_t       n);
+
+/*
+Split n pixels of interleaved RGBA into four planes.
+Returns the count of pixels not fully transparent, alpha above zero:
+zero when a strip is all transparent, and the gradient can skip it.
+*/
+size_t bootchk_deinterleave_rgba (const float *rgba,
+                                  float       *r,
+                                  float       *g,
+                                  float       *b,
+                                  float       *a,
+                                  size_t       n);
+
+/*
+Zero the n pixels of out (n_components floats each)
+whose 3 x 3 neighborhood of alpha is all zero, fully transparent.
+Top, mid, and down are rows of an alpha plane, as for bootchk_gradient_row_planar.
+A pixel's result depends only on its neighborhood,
+not on where the strips or the rois of GEGL fall.
+*/
+void bootchk_clear_transparent (const float *top,
+                                const float *mid,
+                                const float *down,
+                                float       *out,
+                                int          n,
+                                int          n_components);
+
+/*
+False color of n pixels of a gradient field, magnitude and direction,
+into n pixels of HSV, three floats, as bootchk:false-color-filter:
+the direction as the hue, the magnitude's root of emphasis as saturation and value.
+*/
+void bootchk_false_color (const float *in,
+                          float       *out,
+                          size_t       n,
+                          float        emphasis);
+
+/*
+Approximate atan2 (y, x), in [-PI, PI], without branches, so it vectorizes.
+
+A polynomial for atan on [0, 1], Abramowitz and Stegun 4.4.49,
+extended to the circle by octant symmetry.
+The error is at most 1e-5 radians (2e-5 in float arithmetic),
+against libm atan2 over the whole circle.
+Far finer than the hue of a false color, or than NMS needs:
+it rounds directions to 45 degree sectors,
+so only a direction within 2e-5 radians of a sector boundary can differ.
+
+atan2 (0, 0) is 0, as libm.
+*/
+static inline float
+bootchk_fast_atan2 (float y, float x)
+{
+  float ax = fabsf (x);
+  float ay = fabsf (y);
+  float mx = ax > ay ? ax : ay;
+  float mn = ax > ay ? ay : ax;
+  float a  = mn / (mx > FLT_MIN ? mx : FLT_MIN);
+  float s  = a * a;
+  float r  = a * (0.9998660f + s * (-0.3302995f + s * (0.1801410f
+                 + s * (-0.0851330f + s * 0.0208351f))));
+
+  r = ay > ax ? 1.57079637f - r : r;
+  r = x < 0.0f ? 3.14159274f - r : r;
+
+  return copysignf (r, y);
+}
+
+
+/*
+An area filter streamed in strips of rows, for the template of area ops,
+see examples/areaOp and common/area-filter.c.
+
+The filter computes one output row from the 2 * radius + 1 input rows around it,
+each input row padded by radius pixels on both sides.
+The padding is fetched with the rows (by the abyss policy, in GEGL),
+so the filter has no border cases: every pixel takes the fast path.
+
+Input rows are kept in a ring of strip_rows + 2 * radius rows.
+Per strip, fetch gets only the rows the ring doesn't have yet,
+in one call, or two where the ring wraps:
+the halo rows of one strip are rows of the strip before, not fetched again.
+The filter writes each row of the strip into an output strip, then store puts it.
+
+Fetch gets input rows y .. y + n_rows - 1, y relative to the first output row,
+so from -radius, each of width + 2 * radius pixels from x = -radius, contiguous.
+Filter gets rows[0 .. 2 * radius], rows[radius] the row of out,
+each pointing at x = 0, the padding at negative indices.
+Store puts output rows y .. y + n_rows - 1, and returns nonzero to stop.
+*/
+#define BOOTCHK_AREA_MAX_RADIUS 8
+
+typedef struct
+{
+  int    width;           // of the output, pixels
+  int    height;          // of the output, rows
+  int    radius;          // up to BOOTCHK_AREA_MAX_RADIUS
+  int    in_components;   // floats per input pixel
+  int    out_components;  // floats per output pixel
+  int    strip_rows;      // output rows per strip
+  void (*fetch)  (void *data, int y, int n_rows, float *rows);
+  void (*filter) (void *data, const float *const *rows, float *out, int width);
+  int  (*store)  (void *data, int y, int n_rows, const float *rows);
+  void  *data;            // of fetch and store
+  void  *filter_data;     // of filter
+} BootchkAreaStrips;
+
+/* Floats of scratch bootchk_area_run needs: the ring, and an output strip. */
+size_t bootchk_area_scratch_floats (const BootchkAreaStrips *strips);
+
+/* Run the filter over all rows. Returns nonzero when store stopped it. */
+int    bootchk_area_run            (const BootchkAreaStrips *strips,
+                                    float                   *scratch);
@@ -0,0 +1,140 @@
+/*
+A generator of point kernels: one per-pixel function, a loop for each pixel format.
+
+A point op writes the transform of one pixel, on floats,
+
+  static inline void
+  name_pixel (float *v, const void *params)
+
+reading and writing v[0 .. channels - 1], and instantiates the loops around it:
+
+  BOOTCHK_POINT_VARIANTS (name)
+
+which defines name_variants, a loop for each storage type (float, half, u16, u8)
+and 1, 2, and 4 channels, the same count in and out.
+Then in prepare the op takes the format the graph gives it (of its source, if a type here),
+so it runs on the narrowest storage, not converted to float by babl first,
+and in process picks the loop by the format negotiated, see common/point-format.h:
+
+  BootchkPointFunc loop = bootchk_point_lookup (name_variants,
+                                                bootchk_point_type (format),
+                                                babl_format_get_n_components (format));
+
+The pixel function is inlined into the loop over a constant count of channels,
+so where it has no branches (conditional expressions on floats, see kernels/meson.build)
+the compiler vectorizes each loop for the SIMD of the target.
+Integers are normalized, 0 to 1, as babl does: u8 by 255, u16 by 65535, rounded and clamped back.
+Halves are converted a block at a time (F16C where the CPU has it) around the loop of floats.
+
+For an op whose channels in and out differ, BOOTCHK_POINT_LOOP (name, type, in, out)
+instantiates a single loop, name_type_in_out.
+
+Header only: the loops are compiled into the including file, with its flags.
+Include after bootchk-kernels.h, which declares BootchkType and BootchkPointFunc.
+*/
+
+/* Pixels per block of halves converted to floats, on the stack, in cache. */
+#define BOOTCHK_POINT_HALF_BLOCK 256
+
+typedef float    bootchk_point_float_t;
+typedef uint16_t bootchk_point_u16_t;
+typedef uint8_t  bootchk_point_u8_t;
+
+static inline float
+bootchk_point_clamp01 (float v)
+{
+  return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f;  // NaN to 0
+}
+
+#define BOOTCHK_POINT_LOAD_float(c)  (c)
+#define BOOTCHK_POINT_STORE_float(v) (v)
+#define BOOTCHK_POINT_LOAD_u16(c)    ((c) * (1.0f / 65535.0f))
+#define BOOTCHK_POINT_STORE_u16(v)   ((uint16_t) (bootchk_point_clamp01 (v) * 65535.0f + 0.5f))
+#define BOOTCHK_POINT_LOAD_u8(c)     ((c) * (1.0f / 255.0f))
+#define BOOTCHK_POINT_STORE_u8(v)    ((uint8_t) (bootchk_point_clamp01 (v) * 255.0f + 0.5f))
+
+
+/* The loop of name_pixel over pixels of type (float, u16, or u8), channels in and out. */
+#define BOOTCHK_POINT_LOOP(name, type, in_channels, out_channels)                            \
+static void                                                                                  \
+name##_##type##_##in_channels##_##out_channels (const void *in_buf,                          \
+                                                void       *out_buf,                         \
+                                                size_t      n,                               \
+                                                const void *params)                          \
+{                                                                                            \
+  const bootchk_point_##type##_t *in  = in_buf;                                              \
+  bootchk_point_##type##_t       *out = out_buf;                                             \
+  size_t                          i;                                                         \
+                                                                                             \
+  for (i = 0; i < n; i++)                                                                    \
+    {                                                                                        \
+      float v[4];                                                                            \
+      int   c;                                                                               \
+                                                                                             \
+      for (c = 0; c < (in_channels); c++)                                                    \
+        v[c] = BOOTCHK_POINT_LOAD_##type (in[i * (in_channels) + c]);                        \
+                                                                                             \
+      name##_pixel (v, params);                                                              \
+                                                                                             \
+      for (c = 0; c < (out_channels); c++)                                                   \
+        out[i * (out_channels) + c] = BOOTCHK_POINT_STORE_##type (v[c]);                     \
+    }                                                                                        \
+}
+
+/* The loop of halves: blocks converted to floats, through the loop of floats, and back. */
+#define BOOTCHK_POINT_LOOP_HALF(name, channels)                                              \
+static void                                                                                  \
+name##_half_##channels##_##channels (const void *in_buf,                                     \
+                                     void       *out_buf,                                    \
+                                     size_t      n,                                          \
+                                     const void *params)                                     \
+{                                                                                            \
+  const uint16_t *in  = in_buf;                                                              \
+  uint16_t       *out = out_buf;                                                             \
+  size_t          i;                                                                         \
+                                                                                             \
+  for (i = 0; i < n; i += BOOTCHK_POINT_HALF_BLOCK)                                          \
+    {                                                                                        \
+      float  block[BOOTCHK_POINT_HALF_BLOCK * (channels)];                                   \
+      size_t m = n - i < BOOTCHK_POINT_HALF_BLOCK ? n - i : BOOTCHK_POINT_HALF_BLOCK;        \
+                                                                                             \
+      bootchk_half_to_float (in + i * (channels), block, m * (channels));                    \
+      name##_float_##channels##_##channels (block, block, m, params);                        \
+      bootchk_float_to_half (block, out + i * (channels), m * (channels));                   \
+    }                                                                                        \
+}
+
+#define BOOTCHK_POINT_CHANNELS(name, channels)                                               \
+  BOOTCHK_POINT_LOOP (name, float, channels, channels)                                       \
+  BOOTCHK_POINT_LOOP_HALF (name, channels)                                                   \
+  BOOTCHK_POINT_LOOP (name, u16, channels, channels)                                         \
+  BOOTCHK_POINT_LOOP (name, u8, channels, channels)
+
+/* The loops of name_pixel for every type and 1, 2, 4 channels, in name_variants. */
+#define BOOTCHK_POINT_VARIANTS(name)                                                         \
+  BOOTCHK_POINT_CHANNELS (name, 1)                                                           \
+  BOOTCHK_POINT_CHANNELS (name, 2)                                                           \
+  BOOTCHK_POINT_CHANNELS (name, 4)                                                           \
+                                                                                             \
+static const BootchkPointFunc name##_variants[BOOTCHK_N_TYPES][3] =                          \
+{                                                                                            \
+  { name##_float_1_1, name##_float_2_2, name##_float_4_4 },                                  \
+  { name##_half_1_1,  name##_half_2_2,  name##_half_4_4 },                                   \
+  { name##_u16_1_1,   name##_u16_2_2,   name##_u16_4_4 },                                    \
+  { name##_u8_1_1,    name##_u8_2_2,    name##_u8_4_4 },                                     \
+};
+
+
+/* The loop of variants for type and channels, or NULL when none. */
+static inline BootchkPointFunc
+bootchk_point_lookup (const BootchkPointFunc variants[BOOTCHK_N_TYPES][3],
+                      int                    type,
+                      int                    channels)
+{
+  int index = channels == 1 ? 0 : channels == 2 ? 1 : channels == 4 ? 2 : -1;
+
+  if (type < 0 || type >= BOOTCHK_N_TYPES || index < 0)
+    return NULL;
+
+  return variants[type][index];
+}
@@ -0,0 +1,53 @@
+#include "bootchk-isa.h"
+
+#include <math.h>
+
+#include "bootchk-kernels.h"
+#include "bootchk-point.h"
+
+
+
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/*
+The false color of one pixel, see bootchk_false_color.
+Reads the magnitude and direction in v[0] and v[1], before writing hue, saturation, value.
+*/
+static inline void
+false_color_pixel (float *v, const void *params)
+{
+  const float *magnitude_emphasis = params;
+
+  float calculated_hue = (v[1] + M_PI) / (2 * M_PI);
+  float calculated_magnitude = v[0];
+
+  // Amplify/emphasize low values of the gradient magnitude.
+  // Get the nth root of the magnitude to emphasize low values.
+  calculated_magnitude = pow (calculated_magnitude, 1.0 / *magnitude_emphasis);
+
+  v[0] = calculated_hue;
+
+  // Magnitude of the gradient => Value and Saturation in HSV color space.
+  v[2] = calculated_magnitude;
+  v[1] = calculated_magnitude;
+
+  // Alternatively, Constant, full Saturation in HSV color space.
+  // v[1] = 1.0f; // Full saturation
+}
+
+BOOTCHK_POINT_LOOP (false_color, float, 2, 3)
+
+
+void
+bootchk_false_color (
+  const float *in,
+  float       *out,
+  size_t       n,
+  float        emphasis)
+{
+  false_color_float_2_3 (in, out, n, &emphasis);
+}
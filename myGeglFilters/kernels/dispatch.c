@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bootchk-kernels.h"
+#include "bootchk-isa.h"
+
+
+
+
+/*
+The variants the build has, by meson.build: the base always,
+AVX2 and AVX-512 when BOOTCHK_ISA_VARIANTS, on x86 with a compiler for them.
+*/
+#define DECLARE_VARIANTS(type, return_, name, parameters, arguments)                        \
+  type BOOTCHK_ISA_NAME (name, base)   parameters;                                          \
+  type BOOTCHK_ISA_NAME (name, avx2)   parameters;                                          \
+  type BOOTCHK_ISA_NAME (name, avx512) parameters;
+
+BOOTCHK_ISA_KERNELS (DECLARE_VARIANTS)
+
+#define MEMBER(type, return_, name, parameters, arguments) type (*name) parameters;
+
+typedef struct
+{
+  const char *name;
+  int       (*supported) (void);
+  BOOTCHK_ISA_KERNELS (MEMBER)
+} Variant;
+
+
+#ifdef BOOTCHK_ISA_VARIANTS
+
+/* Asked of cpuid, by the compiler's builtins. */
+static int
+cpu_has_avx2 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+}
+
+static int
+cpu_has_avx512 (void)
+{
+  __builtin_cpu_init ();
+  return __builtin_cpu_supports ("avx512f")  && __builtin_cpu_supports ("avx512bw") &&
+         __builtin_cpu_supports ("avx512vl") && __builtin_cpu_supports ("avx512dq");
+}
+
+#endif
+
+static int
+cpu_has_base (void)
+{
+  return 1;
+}
+
+#define ENTRY_BASE(type, return_, name, parameters, arguments)   BOOTCHK_ISA_NAME (name, base),
+#define ENTRY_AVX2(type, return_, name, parameters, arguments)   BOOTCHK_ISA_NAME (name, avx2),
+#define ENTRY_AVX512(type, return_, name, parameters, arguments) BOOTCHK_ISA_NAME (name, avx512),
+
+/* Best last. */
+static const Variant variants[] =
+{
+#if defined (__x86_64__)
+  { "sse2",   cpu_has_base,   BOOTCHK_ISA_KERNELS (ENTRY_BASE) },
+#else
+  { "base",   cpu_has_base,   BOOTCHK_ISA_KERNELS (ENTRY_BASE) },
+#endif
+#ifdef BOOTCHK_ISA_VARIANTS
+  { "avx2",   cpu_has_avx2,   BOOTCHK_ISA_KERNELS (ENTRY_AVX2) },
+  { "avx512", cpu_has_avx512, BOOTCHK_ISA_KERNELS (ENTRY_AVX512) },
+#endif
+};
+
+#define N_VARIANTS ((int) (sizeof (variants) / sizeof (variants[0])))
+
+/*
+Selected once, the first to select winning, by atomics: threads can race to select,
+and read it from then on without a lock.
+*/
+static const Variant *selected = NULL;
+
+
+void
+bootchk_kernels_init (void)
+{
+  const char    *forced  = getenv ("BOOTCHK_CPU");
+  const char    *message = NULL;
+  const Variant *none    = NULL;
+  int            best    = 0;
+  int            i;
+
+  if (__atomic_load_n (&selected, __ATOMIC_ACQUIRE) != NULL)
+    return;
+
+  for (i = N_VARIANTS - 1; i > 0; i--)
+    if (variants[i].supported ())
+      {
+        best = i;
+        break;
+      }
+
+  if (forced != NULL && *forced != '\0')
+    {
+      for (i = 0; i < N_VARIANTS; i++)
+        if (strcmp (forced, variants[i].name) == 0)
+          break;
+
+      if (i == N_VARIANTS)
+        message = "not a variant of this build";
+      else if (! variants[i].supported ())
+        message = "not supported by this CPU";
+      else
+        best = i;
+    }
+
+  // Only the thread that selects reports, once.
+  if (__atomic_compare_exchange_n (&selected, &none, &variants[best], 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) &&
+      message != NULL)
+    fprintf (stderr, "BOOTCHK_CPU=%s: %s, using %s\n", forced, message, variants[best].name);
+}
+
+/* The variant selected, selecting it the first time. */
+static const Variant *
+get_selected (void)
+{
+  const Variant *variant = __atomic_load_n (&selected, __ATOMIC_ACQUIRE);
+
+  if (variant == NULL)
+    {
+      bootchk_kernels_init ();
+      variant = __atomic_load_n (&selected, __ATOMIC_ACQUIRE);
+    }
+
+  return variant;
+}
+
+const char *
+bootchk_kernels_isa (void)
+{
+  return get_selected ()->name;
+}
+
+BootchkNmsSpanFunc
+bootchk_nms_span_func (void)
+{
+  return get_selected ()->bootchk_nms_span;
+}
+
+
+/* The kernels, by their own names: the variant selected. */
+#define DEFINE_KERNEL(type, return_, name, parameters, arguments)                           \
+type                                                                                        \
+name parameters                                                                             \
+{                                                                                           \
+  return_ get_selected ()->name arguments;                                                  \
+}
+
+BOOTCHK_ISA_KERNELS (DEFINE_KERNEL)
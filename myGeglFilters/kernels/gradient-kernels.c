@@ -0,0 +1,300 @@
+#include "bootchk-isa.h"
+
+#include <math.h>
+
+#include "bootchk-kernels.h"
+
+
+
+
+#define POW2(x) ((x)*(x))
+
+
+static inline float
+magnitude (float a, float b)
+{
+  return sqrtf (a*a + b*b);
+}
+
+/*
+Technically, the following is not Sobel
+as it does not use pixel intensities, but works on the individual
+RGB channels. But it is similar to the classic GIMP and PhotoShop
+filter.
+
+See paper "History and Definition of the Sobel Operator" by Irwin
+Sobel that seems to be the only free and authentic description.
+*/
+void
+bootchk_sobel_rgba (
+  const float *src,
+  int          src_width,
+  int          src_height,
+  ptrdiff_t    src_stride,
+  float       *dst,
+  int          dst_width,
+  int          dst_height,
+  ptrdiff_t    dst_stride,
+  int          horizontal,
+  int          vertical,
+  int          keep_sign,
+  int          has_alpha)
+{
+  int x, y;
+
+  for (y = 0; y < dst_height; y++)
+    {
+      /* Rows clamped into src. */
+      const float *row_top    = src + (y > 0 ? y - 1 : y) * src_stride;
+      const float *row_center = src + y * src_stride;
+      const float *row_bottom = src + (y < src_height - 1 ? y + 1 : y) * src_stride;
+      float       *dst_row    = dst + y * dst_stride;
+
+      for (x = 0; x < dst_width; x++)
+        {
+          float hor_grad[3] = {0.0f, 0.0f, 0.0f};
+          float ver_grad[3] = {0.0f, 0.0f, 0.0f};
+          float gradient[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+          /* Columns clamped into src. */
+          int   left  = (x > 0 ? x - 1 : x) * 4;
+          int   col   = x * 4;
+          int   right = (x < src_width - 1 ? x + 1 : x) * 4;
+          const float *tl_px = row_top + left,    *t_px      = row_top + col,    *tr_px = row_top + right;
+          const float *l_px  = row_center + left, *center_px = row_center + col, *r_px  = row_center + right;
+          const float *bl_px = row_bottom + left, *b_px      = row_bottom + col, *br_px = row_bottom + right;
+          int   c;
+
+          if (horizontal)
+            {
+              /*
+               * Horizontal kernel:
+               *
+               *      [-1  0  +1]
+               * Gx = [-2  0  +2] * P
+               *      [-1  0  -1]
+               */
+              for (c = 0; c < 3; c++)
+                {
+                  hor_grad[c] += (-1.0f * tl_px[c]) + (1.0f * tr_px[c]);
+                  hor_grad[c] += (-2.0f * l_px[c]) + (2.0f * r_px[c]);
+                  hor_grad[c] += (-1.0f * bl_px[c]) + (1.0f * br_px[c]);
+                }
+            }
+
+          if (vertical)
+            {
+              /*
+               * Vertical kernel:
+               *
+               *      [+1  +2  +1]
+               * Gy = [ 0   0   0] * P
+               *      [-1  -2  -1]
+               */
+              for (c = 0; c < 3; c++)
+                {
+                  ver_grad[c] += (1.0f * tl_px[c]) + (2.0f * t_px[c]) + (1.0f * tr_px[c]);
+                  ver_grad[c] += (-1.0f * bl_px[c]) + (-2.0f * b_px[c]) + (-1.0f * br_px[c]);
+                }
+            }
+
+          if (horizontal && vertical)
+            {
+               /* sqrt(32.0) = 5.656854 */
+              for (c = 0; c < 3; c++)
+                gradient[c] = magnitude (hor_grad[c], ver_grad[c]) / 5.656854f;
+            }
+          else
+            {
+              if (keep_sign)
+                {
+                  for (c = 0; c < 3; c++)
+                    gradient[c] = 0.5f + (hor_grad[c] + ver_grad[c]) / 8.0f;
+                }
+              else
+                {
+                  for (c = 0; c < 3; c++)
+                    gradient[c] = fabsf (hor_grad[c] + ver_grad[c]) / 4.0f;
+                }
+            }
+
+          if (has_alpha)
+            gradient[3] = center_px[3];
+          else
+            gradient[3] = 1.0f;
+
+          for (c = 0; c < 4; c++)
+            dst_row[x * 4 + c] = gradient[c];
+        }
+    }
+}
+
+
+void
+bootchk_deinterleave_rgb (
+  const float *restrict rgb,
+  float       *restrict r,
+  float       *restrict g,
+  float       *restrict b,
+  size_t                n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      r[i] = rgb[i * 3];
+      g[i] = rgb[i * 3 + 1];
+      b[i] = rgb[i * 3 + 2];
+    }
+}
+
+size_t
+bootchk_deinterleave_rgba (
+  const float *restrict rgba,
+  float       *restrict r,
+  float       *restrict g,
+  float       *restrict b,
+  float       *restrict a,
+  size_t                n)
+{
+  size_t not_transparent = 0;
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    {
+      r[i] = rgba[i * 4];
+      g[i] = rgba[i * 4 + 1];
+      b[i] = rgba[i * 4 + 2];
+      a[i] = rgba[i * 4 + 3];
+      not_transparent += a[i] > 0.0f;
+    }
+
+  return not_transparent;
+}
+
+void
+bootchk_clear_transparent (
+  const float *top,
+  const float *mid,
+  const float *down,
+  float       *out,
+  int          n,
+  int          n_components)
+{
+  int x, c;
+
+  for (x = 0; x < n; x++)
+    {
+      // Maximum, not a sum: alpha is never negative, and no sum rounds a tiny alpha away.
+      float alpha = fmaxf (fmaxf (fmaxf (top[x - 1],  top[x]),  top[x + 1]),
+                           fmaxf (fmaxf (mid[x - 1],  mid[x]),  mid[x + 1]));
+
+      alpha = fmaxf (alpha, fmaxf (fmaxf (down[x - 1], down[x]), down[x + 1]));
+
+      if (alpha <= 0.0f)
+        for (c = 0; c < n_components; c++)
+          out[x * n_components + c] = 0.0f;
+    }
+}
+
+/*
+The gradient at x of the channel having the largest magnitude,
+its squared magnitude, dx, and dy.
+
+Compares the squared magnitudes of the channels, not the magnitudes:
+sqrt is monotonic, so the same channel wins, and only the winner takes a sqrt.
+The selection is by conditional expressions, not branches,
+so the compiler emits blends, and the loops over x vectorize.
+Ties go to the later channel, as gegl:image-gradient.
+*/
+static inline void
+max_channel_gradient (
+  const float *const top[3],
+  const float *const mid[3],
+  const float *const down[3],
+  int                x,
+  float             *sq,
+  float             *dx,
+  float             *dy)
+{
+  float dx0 = mid[0][x-1] - mid[0][x+1], dy0 = top[0][x] - down[0][x];
+  float dx1 = mid[1][x-1] - mid[1][x+1], dy1 = top[1][x] - down[1][x];
+  float dx2 = mid[2][x-1] - mid[2][x+1], dy2 = top[2][x] - down[2][x];
+  float sq0 = POW2(dx0) + POW2(dy0);
+  float sq1 = POW2(dx1) + POW2(dy1);
+  float sq2 = POW2(dx2) + POW2(dy2);
+  int   first = sq0 > sq1;
+  float s     = first ? sq0 : sq1;
+  float x_max = first ? dx0 : dx1;
+  float y_max = first ? dy0 : dy1;
+  int   last  = sq2 > s;
+
+  *sq = last ? sq2 : s;
+  *dx = last ? dx2 : x_max;
+  *dy = last ? dy2 : y_max;
+}
+
+/*
+The row, with output and squared constants after inlining,
+so each combination is its own loop, not a test per pixel.
+*/
+static inline void
+gradient_row (
+  const float *const    top[3],
+  const float *const    mid[3],
+  const float *const    down[3],
+  float *restrict       out,
+  int                   n,
+  BootchkGradientOutput output,
+  int                   squared)
+{
+  // Local copies of the plane pointers, so they stay in registers across the loop.
+  const float *t[3] = { top[0],  top[1],  top[2]  };
+  const float *m[3] = { mid[0],  mid[1],  mid[2]  };
+  const float *d[3] = { down[0], down[1], down[2] };
+  float        sq, dx, dy;
+  int          x;
+
+  switch (output)
+    {
+    case BOOTCHK_GRADIENT_MAGNITUDE:
+      for (x = 0; x < n; x++)
+        {
+          max_channel_gradient (t, m, d, x, &sq, &dx, &dy);
+          out[x] = squared ? sq : sqrtf (sq);
+        }
+      break;
+
+    case BOOTCHK_GRADIENT_DIRECTION:
+      for (x = 0; x < n; x++)
+        {
+          max_channel_gradient (t, m, d, x, &sq, &dx, &dy);
+          out[x] = bootchk_fast_atan2 (dy, dx);
+        }
+      break;
+
+    default:
+      for (x = 0; x < n; x++)
+        {
+          max_channel_gradient (t, m, d, x, &sq, &dx, &dy);
+          out[x * 2]     = squared ? sq : sqrtf (sq);
+          out[x * 2 + 1] = bootchk_fast_atan2 (dy, dx);
+        }
+      break;
+    }
+}
+
+void
+bootchk_gradient_row_planar (
+  const float *const    top[3],
+  const float *const    mid[3],
+  const float *const    down[3],
+  float *restrict       out,
+  int                   n,
+  BootchkGradientOutput output,
+  int                   squared)
+{
+  if (squared)
+    gradient_row (top, mid, down, out, n, output, 1);
+  else
+    gradient_row (top, mid, down, out, n, output, 0);
+}
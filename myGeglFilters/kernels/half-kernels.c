@@ -0,0 +1,183 @@
+#include <string.h>
+
+#include "bootchk-kernels.h"
+
+
+
+
+/*
+Scalar conversions, for CPUs without F16C, and for the tails of the vector loops.
+Bit manipulation, after F. Giesen's half <-> float conversions,
+so the same results as F16C: round to nearest even, subnormals kept,
+overflow to infinity, NaN to a quiet NaN.
+*/
+static float
+float_of_half (uint16_t h)
+{
+  const uint32_t exponent_mask = 0x7c00u << 13;  // of a half, shifted to a float's place
+  uint32_t       bits          = (uint32_t) (h & 0x7fffu) << 13;
+  uint32_t       exponent      = bits & exponent_mask;
+  float          f;
+
+  bits += (uint32_t) (127 - 15) << 23;  // Rebias the exponent.
+
+  if (exponent == exponent_mask)
+    bits += (uint32_t) (128 - 16) << 23;  // Infinity or NaN: the float's maximum exponent.
+  else if (exponent == 0)
+    {
+      // Zero or subnormal: renormalize, by subtracting the implicit one of the smallest normal.
+      const uint32_t smallest_normal_bits = 113u << 23;  // 2^-14
+      float          smallest_normal;
+
+      memcpy (&smallest_normal, &smallest_normal_bits, sizeof (float));
+      bits += 1u << 23;
+      memcpy (&f, &bits, sizeof (float));
+      f -= smallest_normal;
+      memcpy (&bits, &f, sizeof (float));
+    }
+
+  bits |= (uint32_t) (h & 0x8000u) << 16;
+  memcpy (&f, &bits, sizeof (float));
+
+  return f;
+}
+
+static uint16_t
+half_of_float (float f)
+{
+  const uint32_t infinity_bits   = 255u << 23;
+  const uint32_t overflow_bits   = (127u + 16) << 23;  // 65536, rounds to infinity
+  const uint32_t subnormal_bits  = 113u << 23;         // 2^-14, the smallest normal half
+  const uint32_t magic_bits      = ((127u - 15) + (23 - 10) + 1) << 23;  // 0.5
+  uint32_t       bits;
+  uint32_t       sign;
+  uint16_t       h;
+
+  memcpy (&bits, &f, sizeof (float));
+  sign  = bits & 0x80000000u;
+  bits ^= sign;
+
+  if (bits >= overflow_bits)
+    h = bits > infinity_bits ? 0x7e00 : 0x7c00;  // NaN to a quiet NaN, else infinity
+  else if (bits < subnormal_bits)
+    {
+      // Subnormal or zero: adding 0.5 aligns the mantissa, the FPU rounds it.
+      float magic;
+      float sum;
+
+      memcpy (&magic, &magic_bits, sizeof (float));
+      memcpy (&sum, &bits, sizeof (float));
+      sum += magic;
+      memcpy (&bits, &sum, sizeof (float));
+      h = (uint16_t) (bits - magic_bits);
+    }
+  else
+    {
+      uint32_t odd = (bits >> 13) & 1;  // Ties to even.
+
+      bits += ((uint32_t) (15 - 127) << 23) + 0xfff + odd;
+      h     = (uint16_t) (bits >> 13);
+    }
+
+  return h | (uint16_t) (sign >> 16);
+}
+
+static void
+half_to_float_scalar (const uint16_t *in, float *out, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    out[i] = float_of_half (in[i]);
+}
+
+static void
+float_to_half_scalar (const float *in, uint16_t *out, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    out[i] = half_of_float (in[i]);
+}
+
+
+#if defined (__GNUC__) && (defined (__x86_64__) || defined (__i386__))
+
+#include <immintrin.h>
+
+/*
+F16C: eight conversions per instruction.
+Compiled for F16C whatever the compiler flags, and called only when the CPU has it.
+*/
+__attribute__ ((target ("avx,f16c")))
+static void
+half_to_float_f16c (const uint16_t *in, float *out, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm256_storeu_ps (out + i, _mm256_cvtph_ps (_mm_loadu_si128 ((const __m128i *) (in + i))));
+
+  half_to_float_scalar (in + i, out + i, n - i);
+}
+
+__attribute__ ((target ("avx,f16c")))
+static void
+float_to_half_f16c (const float *in, uint16_t *out, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    _mm_storeu_si128 ((__m128i *) (out + i),
+                      _mm256_cvtps_ph (_mm256_loadu_ps (in + i), _MM_FROUND_TO_NEAREST_INT));
+
+  float_to_half_scalar (in + i, out + i, n - i);
+}
+
+/*
+Asked once. Racing threads store the same answer.
+With the AVX2 and AVX-512 variants of the kernels, not the base:
+so BOOTCHK_CPU=sse2 benches the conversions without F16C too.
+*/
+static int
+cpu_has_f16c (void)
+{
+  static int has_f16c = -1;
+
+  if (has_f16c < 0)
+    {
+      __builtin_cpu_init ();
+      has_f16c = __builtin_cpu_supports ("avx") && __builtin_cpu_supports ("f16c") &&
+                 strcmp (bootchk_kernels_isa (), "sse2") != 0;
+    }
+
+  return has_f16c;
+}
+
+#else
+
+static int cpu_has_f16c (void) { return 0; }
+
+#define half_to_float_f16c half_to_float_scalar
+#define float_to_half_f16c float_to_half_scalar
+
+#endif
+
+
+void
+bootchk_half_to_float (const uint16_t *in, float *out, size_t n)
+{
+  if (cpu_has_f16c ())
+    half_to_float_f16c (in, out, n);
+  else
+    half_to_float_scalar (in, out, n);
+}
+
+void
+bootchk_float_to_half (const float *in, uint16_t *out, size_t n)
+{
+  if (cpu_has_f16c ())
+    float_to_half_f16c (in, out, n);
+  else
+    float_to_half_scalar (in, out, n);
+}
@@ -0,0 +1,158 @@
+#include "bootchk-isa.h"
+
+#include <string.h>
+
+#include "bootchk-kernels.h"
+
+
+
+
+#define FPP 2 // Floats per pixel (magnitude and direction)
+
+/* The BOOTCHK_HYST_WEAK bit of each of eight bytes in a word. */
+#define HYST_WEAK_WORD UINT64_C (0x0101010101010101)
+
+
+/*
+Does any of the eight pixels starting at states have BOOTCHK_HYST_WEAK.
+Lets the scan skip runs of pixels that can't be promoted, a word at a time.
+*/
+static inline int
+is_any_weak_in_word (const uint8_t *states)
+{
+  uint64_t word;
+
+  memcpy (&word, states, sizeof (word));
+  return (word & HYST_WEAK_WORD) != 0;
+}
+
+/*
+Check if pixel at row, col is connected to strong edges/neighbors.
+8-connected neighborhood (alternative is 4 or 6 connected).
+Returns true if any neighbor is strong.
+
+On the edges of the plane, neighbors are clamped into the plane,
+so the pixel is its own neighbor.
+*/
+static inline int
+is_connected_to_strong (
+  const uint8_t *states,
+  int            width,
+  int            height,
+  ptrdiff_t      stride,
+  int            row,
+  int            col)
+{
+  const uint8_t *here  = states + row * stride;
+  const uint8_t *above = row > 0          ? here - stride : here;
+  const uint8_t *below = row < height - 1 ? here + stride : here;
+  int            left  = col > 0          ? col - 1 : col;
+  int            right = col < width - 1  ? col + 1 : col;
+
+  // assert center is weak, we don't check it here.
+  return ((above[left] | above[col] | above[right] |
+           here[left]  |              here[right]  |
+           below[left] | below[col] | below[right]) & BOOTCHK_HYST_STRONG) != 0;
+}
+
+
+void
+bootchk_hyst_states_of_row (
+  const float *in,
+  int          pixel_stride,
+  uint8_t     *states,
+  int          n)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    states[i] = bootchk_hyst_state_of_magnitude (in[i * pixel_stride]);
+}
+
+void
+bootchk_hyst_write_row (
+  const float       *in,
+  const uint8_t     *states,
+  float             *out,
+  int                n,
+  int                remove_weak,
+  BootchkHystCounts *counts)
+{
+  size_t none = 0;
+  size_t weak = 0;
+  int    i;
+
+  for (i = 0; i < n; i++)
+    {
+      float magnitude = in[i * FPP];
+
+      // Counted in the same loop, nearly free: the states are already loaded.
+      none += states[i] == 0;
+      weak += (states[i] & BOOTCHK_HYST_WEAK) != 0;
+
+      if (remove_weak)
+        /* Strong: white, or promoted. */
+        out[i * FPP] = (states[i] != 0 && ! (states[i] & BOOTCHK_HYST_WEAK)) ? 1.0 : 0.0;
+      /* Was weak, and is no longer: promoted. */
+      else if (bootchk_is_weak_magnitude (magnitude) && ! (states[i] & BOOTCHK_HYST_WEAK))
+        out[i * FPP] = 1.0;
+      else
+        out[i * FPP] = magnitude;
+
+      out[i * FPP + 1] = in[i * FPP + 1];
+    }
+
+  if (counts != NULL)
+    {
+      counts->none   += none;
+      counts->weak   += weak;
+      counts->strong += n - none - weak;
+    }
+}
+
+/*
+Raster scan the state plane, promoting center weak to strong.
+Alternate design would scan for strong pixels,
+and promote neighbors weak to strong.
+We anticipate edges are thin, with few neighbors to promote.
+*/
+size_t
+bootchk_hyst_brushfire (
+  uint8_t  *states,
+  int       width,
+  int       height,
+  ptrdiff_t stride)
+{
+  size_t promoted_count = 0;
+  int    row, col;
+
+  for (row = 0; row < height; row++)
+    {
+      uint8_t *row_states = states + row * stride;
+
+      for (col = 0; col < width; col++)
+        {
+          // Most pixels are not weak, skip them a word at a time.
+          if ((col & 7) == 0 &&
+              col + 8 <= width &&
+              ! is_any_weak_in_word (row_states + col))
+            {
+              col += 7;
+              continue;
+            }
+
+          if (! (row_states[col] & BOOTCHK_HYST_WEAK))
+            continue;  // Not weak, skip.
+
+          if (is_connected_to_strong (states, width, height, stride, row, col))
+            {
+              // Promote to strong, will be viewed as white.
+              row_states[col] = BOOTCHK_HYST_STRONG;
+              promoted_count++;
+            }
+          // else remains weak.
+        }
+    }
+
+  return promoted_count;
+}
@@ -0,0 +1,189 @@
+#include "bootchk-isa.h"
+
+#include <float.h>
+#include <math.h>
+
+#include "bootchk-kernels.h"
+
+
+
+
+#define FPP 2 // Floats per pixel (magnitude and direction)
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+
+/*
+Define the clamped axis for gradient directions.
+
+Clamp gradient vectors to the nearest 45 degree axis.
+
+The axis NS (North-South) is 0 degrees.
+There are four axes (not eight).
+
+Up and down vectors, north to south and south to north, are clamped to the same axis.
+*/
+
+typedef enum
+{
+  AXIS_NS   = 0,
+  AXIS_NW_SE,
+  AXIS_EW,
+  AXIS_SW_NE
+} DirectionAxis;
+
+
+/*
+Gradient is two channels, second is an angle in radians [-pi, pi],
+using the East-Counterclockwise Convention
+(0 degrees is East, 90 degrees is North, 180 degrees is West, -90 degrees is South)
+i.e. computed by atan2 (dy, dx).
+
+The implementation is not efficient, but it is simple and clear.
+That is, we don't need to convert convention, normalize, or work in degrees,
+except for intuitive understanding of the result.
+*/
+static DirectionAxis
+clamped_axis_of_vector (const float *vector)
+{
+  float angle = vector[1];
+
+  // Normalize angle to [0, 2 pi) degrees.
+  if (angle < 0)
+    angle += 2 * M_PI; // Convert negative angle to positive.
+  else if (angle >= 2 * M_PI)
+    angle -= 2 * M_PI; // Convert angle greater than 2 pi  to [0, 2 pi).
+
+  // Convert radians to degrees.
+  angle = angle * 180.0 / M_PI;
+
+  // Remember that the angle is in East-Counterclockwise Convention.
+  if (angle < 22.5 || angle >= 337.5)
+    return AXIS_EW;
+  else if (angle >= 22.5 && angle < 67.5)
+    return AXIS_NW_SE;
+  else if (angle >= 67.5 && angle < 112.5)
+    return AXIS_NS;
+  else if (angle >= 112.5 && angle < 157.5)
+    return AXIS_SW_NE;
+  else if (angle >= 157.5 && angle < 202.5)
+    return AXIS_EW;
+  else if (angle >= 202.5 && angle < 247.5)
+    return AXIS_NW_SE;
+  else if (angle >= 247.5 && angle < 292.5)
+    return AXIS_NS;
+  else
+    // angle >= 292.5 && angle < 337.5
+    return AXIS_SW_NE;
+}
+
+/*
+Is magnitude a greater than magnitude b.
+
+When squared, a and b are squared magnitudes,
+and the answer is the same as comparing their square roots, sqrtf, exactly.
+sqrtf is monotonic, but two squares a few ulps apart can have the same sqrtf,
+i.e. a tie of the magnitudes, and a tie is not greater.
+So only near a tie take the square roots to decide.
+Squares apart by more than 4 FLT_EPSILON relatively (or FLT_MIN, near zero)
+have square roots apart by more than their rounding.
+*/
+static inline int
+is_greater_magnitude (float a, float b, int squared)
+{
+  if (! squared)
+    return a > b;
+  else if (a > b * (1.0f + 4 * FLT_EPSILON) + FLT_MIN)
+    return 1;
+  else
+    return sqrtf (a) > sqrtf (b);
+}
+
+/*
+Check if center is a local maximum magnitude
+in the clamped direction of the gradient.
+
+Local with respect to two neighbor pixel gradient magnitudes.
+
+All arguments are pointers to pixels
+having two channels: magnitude and direction,
+representing a vector at that pixel.
+When squared, the magnitudes are squared.
+*/
+static int
+is_gradient_magnitude_a_local_maximum (
+  const float *top_left,    const float *top,    const float *top_right,
+  const float *left,        const float *center, const float *right,
+  const float *bottom_left, const float *bottom, const float *bottom_right,
+  int          squared)
+{
+  switch (clamped_axis_of_vector (center))
+  {
+    // Is center magnitude greater than its...
+    case AXIS_NS:
+      // vertical neighbors?
+      return is_greater_magnitude (center[0], top[0], squared) &&
+             is_greater_magnitude (center[0], bottom[0], squared);
+    case AXIS_NW_SE:
+      // first diagonal neighbors?
+      return is_greater_magnitude (center[0], top_left[0], squared) &&
+             is_greater_magnitude (center[0], bottom_right[0], squared);
+    case AXIS_EW:
+      // horizontal neighbors?
+      return is_greater_magnitude (center[0], left[0], squared) &&
+             is_greater_magnitude (center[0], right[0], squared);
+    case AXIS_SW_NE:
+    default:
+      // second diagonal neighbors?
+      return is_greater_magnitude (center[0], bottom_left[0], squared) &&
+             is_greater_magnitude (center[0], top_right[0], squared);
+  }
+}
+
+
+void
+bootchk_nms_span (
+  const float *top,
+  const float *mid,
+  const float *bottom,
+  float       *out,
+  int          n,
+  int          squared)
+{
+  int i;
+
+  for (i = 0; i < n; i++)
+    {
+      const float *center = mid + i * FPP;
+      const float *up     = top + i * FPP;
+      const float *down   = bottom + i * FPP;
+
+      if (is_gradient_magnitude_a_local_maximum (
+            up - FPP,     up,     up + FPP,
+            center - FPP, center, center + FPP,
+            down - FPP,   down,   down + FPP,
+            squared))
+        out[i * FPP] = center[0];  // keep its magnitude component.
+      else
+        out[i * FPP] = 0;          // viewed as black
+
+      // Keep direction component, unchanged.
+      out[i * FPP + 1] = center[1];
+    }
+}
+
+int
+bootchk_is_black (
+  const float *in,
+  size_t       n)
+{
+  size_t i;
+
+  for (i = 0; i < n; i++)
+    if (in[i * FPP] != 0.0f)
+      return 0;
+
+  return 1;
+}
@@ -0,0 +1,115 @@
+#include "bootchk-isa.h"
+
+#include <math.h>
+
+#include "bootchk-kernels.h"
+#include "bootchk-point.h"
+
+
+
+
+/*
+The double threshold of one pixel, its first channel, the others unchanged.
+Conditional expressions, not branches, so the loops of bootchk-point.h vectorize.
+*/
+static inline void
+threshold_pixel (float *v, const void *params)
+{
+  const BootchkThresholdParams *p = params;
+  float                         c = v[0];
+
+  // Black below low, white above high, else unchanged.
+  v[0] = c < p->low ? 0.0f : (c > p->high ? 1.0f : c);
+}
+
+/* Of a squared magnitude: between the thresholds, the magnitude. */
+static inline void
+threshold_squared_pixel (float *v, const void *params)
+{
+  const BootchkThresholdParams *p = params;
+  float                         c = v[0];
+
+  v[0] = c < p->low ? 0.0f : (c > p->high ? 1.0f : sqrtf (c));
+}
+
+BOOTCHK_POINT_VARIANTS (threshold)
+BOOTCHK_POINT_VARIANTS (threshold_squared)
+
+
+BootchkPointFunc
+bootchk_threshold_point (BootchkType type,
+                         int         channels,
+                         int         squared)
+{
+  return bootchk_point_lookup (squared ? threshold_squared_variants : threshold_variants,
+                               type, channels);
+}
+
+void
+bootchk_double_threshold (
+  const float *in,
+  float       *out,
+  long         n,
+  float        low,
+  float        high)
+{
+  BootchkThresholdParams params = { low, high };
+
+  threshold_float_2_2 (in, out, n, &params);
+}
+
+
+void
+bootchk_double_threshold_squared (
+  const float *in,
+  float       *out,
+  long         n,
+  float        low,
+  float        high)
+{
+  BootchkThresholdParams params = { low, high };
+
+  threshold_squared_float_2_2 (in, out, n, &params);
+}
+
+
+/*
+Start from the rounded product, then step by ulps to the exact boundary.
+sqrtf is correctly rounded and monotonic, so the boundary is a single float,
+and the product is within a few ulps of it.
+*/
+void
+bootchk_squared_threshold (
+  float  low,
+  float  high,
+  float *low_squared,
+  float *high_squared)
+{
+  float s;
+
+  /* Smallest s having sqrtf (s) >= low. No magnitude is below a low <= 0. */
+  if (low <= 0)
+    s = 0;
+  else
+    {
+      s = low * low;
+      while (sqrtf (s) < low)
+        s = nextafterf (s, INFINITY);
+      while (s > 0 && sqrtf (nextafterf (s, 0)) >= low)
+        s = nextafterf (s, 0);
+    }
+  *low_squared = s;
+
+  /* Largest s having sqrtf (s) <= high. Every magnitude is above a high < 0. */
+  if (high < 0)
+    s = -1;
+  else
+    {
+      s = high * high;
+      while (sqrtf (s) > high)
+        s = nextafterf (s, 0);
+      while (sqrtf (nextafterf (s, INFINITY)) <= high)
+        s = nextafterf (s, INFINITY);
+    }
+  *high_squared = s;
+}
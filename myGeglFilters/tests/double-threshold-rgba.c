@@ -0,0 +1,107 @@
+/*
+bootchk:double-threshold of a color image thresholds its luminance,
+converted to Y'A of the image's type, not the red channel of the image's own format.
+
+The pixels are black, white, red, and green, thresholds 0.6 and 0.8:
+the luminance of red (Y' 0.5) is below the low threshold, of green (0.87) above the high,
+where their red channels are the other way round.
+Also the formats bootchk_point_format negotiates, of color, gray, and components:
+linear gray is converted to Y', the luminance the thresholds are of.
+*/
+
+#include <stdlib.h>
+
+#include <gegl.h>
+
+#include "bootchk-kernels.h"
+#include "point-format.h"
+
+
+#define N_PIXELS 4
+
+static gint failures = 0;
+
+static void
+expect_format (const gchar *source,
+               const gchar *expected)
+{
+  const Babl *format = bootchk_point_format (babl_format (source), NULL, NULL);
+
+  if (format != babl_format (expected))
+    {
+      g_printerr ("format of %s: %s, expected %s\n", source, babl_get_name (format), expected);
+      failures++;
+    }
+}
+
+static void
+expect_threshold (void)
+{
+  static const guint8  rgba[N_PIXELS * 4] = {   0,   0,   0, 255,
+                                              255, 255, 255, 255,
+                                              255,   0,   0, 255,
+                                                0, 255,   0, 255 };
+  static const gfloat  expected[N_PIXELS] = { 0.0f, 1.0f, 0.0f, 1.0f };
+  GeglRectangle        extent             = { 0, 0, N_PIXELS, 1 };
+  GeglBuffer          *buffer             = gegl_buffer_new (&extent, babl_format ("R'G'B'A u8"));
+  GeglNode            *graph              = gegl_node_new ();
+  GeglNode            *source;
+  GeglNode            *threshold;
+  gfloat               out[N_PIXELS * 2];
+  gint                 i;
+
+  gegl_buffer_set (buffer, &extent, 0, NULL, rgba, GEGL_AUTO_ROWSTRIDE);
+
+  source    = gegl_node_new_child (graph,
+                                   "operation", "gegl:buffer-source",
+                                   "buffer",    buffer,
+                                   NULL);
+  threshold = gegl_node_new_child (graph,
+                                   "operation",      "bootchk:double-threshold",
+                                   "low-threshold",  0.6,
+                                   "high-threshold", 0.8,
+                                   NULL);
+  gegl_node_link (source, threshold);
+
+  gegl_node_blit (threshold, 1.0, &extent, babl_format ("Y'A float"),
+                  out, GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+
+  for (i = 0; i < N_PIXELS; i++)
+    if (out[i * 2] != expected[i] || out[i * 2 + 1] != 1.0f)
+      {
+        g_printerr ("pixel %d: Y'A %g %g, expected %g 1\n",
+                    i, out[i * 2], out[i * 2 + 1], expected[i]);
+        failures++;
+      }
+
+  g_object_unref (graph);
+  g_object_unref (buffer);
+}
+
+gint
+main (gint    argc,
+      gchar **argv)
+{
+  gegl_init (&argc, &argv);
+
+  if (! gegl_has_operation ("bootchk:double-threshold"))
+    {
+      g_printerr ("bootchk:double-threshold not found in GEGL_PATH\n");
+      gegl_exit ();
+      return EXIT_FAILURE;
+    }
+
+  expect_format ("R'G'B'A u8",    "Y'A u8");
+  expect_format ("RGBA float",    "Y'A float");
+  expect_format ("R'G'B' u16",    "Y'A u16");
+  expect_format ("Y'A u8",        "Y'A u8");
+  expect_format ("Y' u16",        "Y' u16");
+  expect_format ("Y float",       "Y'A float");
+  expect_format ("YA u8",         "Y'A u8");
+  expect_format ("Y'A double",    "Y'A float");
+  expect_threshold ();
+
+  gegl_exit ();
+
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,704 @@
+/*
+Run bootchk:canny over an image from the command line, outside GIMP.
+
+For images too large for memory, e.g. gigapixel mosaics:
+hysteresis streams strips (--strip-height), the other steps are local,
+and GEGL swaps tiles to disk beyond its cache.
+Reports the elapsed time and the peak resident memory,
+to show the memory is bounded by the cache and strips, not the image.
+Also the time of gegl_init, which loads every plug-in module,
+to compare the ops built as one module (meson option bundle) or one module each.
+Then the statistics of hysteresis, read back from its node.
+
+Usage:
+
+  bootchk-batch [OPTION...] INPUT OUTPUT
+  bootchk-batch [OPTION...] --synthetic 50000x50000 [OUTPUT]
+  bootchk-batch [OPTION...] --sequence FRAME...
+
+INPUT is loaded by gegl:load, OUTPUT saved by gegl:save, the format by extension.
+Except .pfm, .pgm, and .raw, which are memory mapped, see buffer-io.h,
+so that elapsed is canny, not decoding and encoding PNG.
+A .raw file has no header: give its size by --raw WxH, its format by --raw-format,
+e.g. "Y float" (the default), "Y' u8", or "RGBA float".
+
+  bootchk-batch --raw 8000x6000 --raw-format "Y' u8" scan.raw edges.pgm
+Without OUTPUT the result is computed and discarded, to measure canny alone.
+Synthetic input is perlin noise, no file needed.
+
+With --gradient FILE and --nms FILE, also saves canny's gradient and thinned gradient,
+from its extra output pads, in false color, by bootchk:false-color-filter.
+The gradient is computed once for all outputs: elapsed is the time of the combined job.
+
+With --half, canny stores its intermediates in half floats (canny's half-precision),
+half the memory and cache, e.g. for images that otherwise swap.
+See bootchk-bench -H for how many edge pixels differ.
+
+With --draft, canny's quality is draft, as for a live preview:
+compare elapsed and --latency to the final quality.
+
+With --preview WxH, measures draft against the budget of a live preview, 30 ms a render:
+renders a view of WxH at the center in draft, after each of 10 changes of the strong threshold,
+as while dragging a slider, and reports the median and worst render and how many were in budget.
+Then commits as a filter tool should: quality final, the threshold as given,
+rendering the whole image, to OUTPUT when given. Elapsed is of the commit.
+
+  bootchk-batch --preview 1280x720 photo.png edges.png
+
+With --sequence, the arguments are frames, e.g. of a fixed camera,
+and canny recomputes only the tiles (of --tile-size) that changed from the frame before,
+see sequence.h. Saves the edges of frame N by --frame-output PATTERN, e.g. edges-%04d.png.
+Reports per frame the tiles reused and the latency.
+
+  bootchk-batch --sequence --frame-output edges-%04d.png frame-*.png
+
+With --cache, results persist in $XDG_CACHE_HOME/bootchk-canny, see result-cache.h,
+keyed by the input's pixels and canny's parameters and version:
+running again over the same input skips canny, and reports the time saved.
+The output is then the binary edge map, gray without alpha, hit or miss.
+--cache-size caps the cache, evicting the least recently used.
+
+With --latency MS, measures interactive re-render latency, as in GIMP's live preview:
+renders in a thread, changes the strong threshold after MS milliseconds,
+and reports how long until the stale render gives way, and until the fresh one is done.
+
+The GEGL environment bounds the memory, e.g.:
+
+  GEGL_CACHE_SIZE=2048  cache in MiB
+  GEGL_SWAP=/scratch    directory for the swap file, on a disk with room
+                        (a 50k x 50k image of RGBA float is 40GB)
+
+The canny plugins must be installed where GEGL looks, see vagga.yaml.
+*/
+
+#include <gegl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+
+#include "buffer-io.h"
+#include "result-cache.h"
+#include "sequence.h"
+
+
+static gchar   *synthetic    = NULL;
+static gint     strip_height = 1024;
+static gdouble  blur_amount  = 1.0;
+static gdouble  weak         = 0.3;
+static gdouble  strong       = 0.8;
+static gboolean quiet        = FALSE;
+static gint     latency_ms   = 0;
+static gchar   *gradient_path = NULL;
+static gchar   *nms_path      = NULL;
+static gboolean half          = FALSE;
+static gboolean draft         = FALSE;
+static gboolean sequence      = FALSE;
+static gchar   *frame_output  = NULL;
+static gint     tile_size     = 128;
+static gboolean use_cache     = FALSE;
+static gint     cache_mib     = 1024;
+static gchar   *raw_size      = NULL;
+static gchar   *raw_format    = NULL;
+static gchar   *preview_size  = NULL;
+
+static GOptionEntry entries[] =
+{
+  { "synthetic",    's', 0, G_OPTION_ARG_STRING, &synthetic,
+    "Process perlin noise of size WxH instead of an input file", "WxH" },
+  { "strip-height", 'r', 0, G_OPTION_ARG_INT,    &strip_height,
+    "Rows per strip of hysteresis, 0 for the whole image in memory", "ROWS" },
+  { "blur",         'b', 0, G_OPTION_ARG_DOUBLE, &blur_amount,
+    "Blur amount", "STD_DEV" },
+  { "weak",         'w', 0, G_OPTION_ARG_DOUBLE, &weak,
+    "Weak threshold", "T" },
+  { "strong",       'S', 0, G_OPTION_ARG_DOUBLE, &strong,
+    "Strong threshold", "T" },
+  { "quiet",        'q', 0, G_OPTION_ARG_NONE,   &quiet,
+    "Don't report progress", NULL },
+  { "latency",      'l', 0, G_OPTION_ARG_INT,    &latency_ms,
+    "Change a parameter after MS milliseconds of rendering, report re-render latency", "MS" },
+  { "gradient",     'g', 0, G_OPTION_ARG_FILENAME, &gradient_path,
+    "Also save canny's gradient to FILE, in false color", "FILE" },
+  { "nms",          'n', 0, G_OPTION_ARG_FILENAME, &nms_path,
+    "Also save canny's thinned gradient to FILE, in false color", "FILE" },
+  { "half",         'H', 0, G_OPTION_ARG_NONE,     &half,
+    "Store canny's intermediates in half floats", NULL },
+  { "draft",        'd', 0, G_OPTION_ARG_NONE,     &draft,
+    "Canny's draft quality, fast and approximate", NULL },
+  { "preview",      'P', 0, G_OPTION_ARG_STRING,   &preview_size,
+    "Time draft renders of a WxH view against the preview budget, then commit in final", "WxH" },
+  { "sequence",     'Q', 0, G_OPTION_ARG_NONE,     &sequence,
+    "The arguments are frames, recompute only the tiles that changed", NULL },
+  { "frame-output", 'o', 0, G_OPTION_ARG_STRING,   &frame_output,
+    "In a sequence, save the edges of frame N to PATTERN", "PATTERN" },
+  { "tile-size",    't', 0, G_OPTION_ARG_INT,      &tile_size,
+    "In a sequence, the pixels square compared between frames", "PIXELS" },
+  { "cache",        'c', 0, G_OPTION_ARG_NONE,     &use_cache,
+    "Reuse the result of an earlier run over the same input and parameters", NULL },
+  { "cache-size",   'C', 0, G_OPTION_ARG_INT,      &cache_mib,
+    "Size cap of the cache", "MIB" },
+  { "raw",          'R', 0, G_OPTION_ARG_STRING,   &raw_size,
+    "Size of .raw files, which have no header", "WxH" },
+  { "raw-format",   'F', 0, G_OPTION_ARG_STRING,   &raw_format,
+    "Babl format of .raw files", "FORMAT" },
+  { NULL }
+};
+
+
+/* Peak resident memory of this process, in MiB. */
+static gdouble
+peak_rss_mib (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return 0.0;
+
+  // Linux reports kilobytes.
+  return usage.ru_maxrss / 1024.0;
+}
+
+/* Return a canny node of the options. */
+static GeglNode *
+make_canny (GeglNode *graph)
+{
+  return gegl_node_new_child (graph,
+                              "operation",        "bootchk:canny",
+                              "blur-amount",      blur_amount,
+                              "weak-threshold",   weak,
+                              "strong-threshold", strong,
+                              "strip-height",     strip_height,
+                              "half-precision",   half,
+                              "quality",          draft ? 1 : 0,  // BOOTCHK_CANNY_QUALITY_DRAFT, else final
+                              NULL);
+}
+
+/* Return a node producing perlin noise over width x height. */
+static GeglNode *
+make_synthetic_source (GeglNode *graph, gint width, gint height)
+{
+  GeglNode *noise = gegl_node_new_child (graph,
+                                         "operation", "gegl:perlin-noise",
+                                         "scale",     0.05,
+                                         NULL);
+  GeglNode *crop  = gegl_node_new_child (graph,
+                                         "operation", "gegl:crop",
+                                         "width",     (gdouble) width,
+                                         "height",    (gdouble) height,
+                                         NULL);
+
+  gegl_node_link (noise, crop);
+
+  return crop;
+}
+
+/*
+Set the layout of .raw files from the options, after gegl_init, which inits babl.
+FALSE, after a message, when the options are invalid.
+*/
+static gboolean
+set_raw_layout (void)
+{
+  gint width  = 0;
+  gint height = 0;
+
+  if (raw_size != NULL &&
+      (sscanf (raw_size, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0))
+    {
+      g_printerr ("Raw size must be WxH, e.g. 4000x3000\n");
+      return FALSE;
+    }
+
+  if (raw_format != NULL && ! babl_format_exists (raw_format))
+    {
+      g_printerr ("%s: not a babl format\n", raw_format);
+      return FALSE;
+    }
+
+  buffer_io_set_raw (width, height,
+                     babl_format (raw_format != NULL ? raw_format : "Y float"));
+
+  return TRUE;
+}
+
+/*
+Return a sink saving pad of canny to path, in false color.
+The magnitudes of canny's pads are squared: false color takes them so,
+and shows them as bootchk:false-color-gradient-filter shows magnitudes.
+*/
+static GeglNode *
+make_false_color_sink (GeglNode *graph, GeglNode *canny, const gchar *pad, const gchar *path)
+{
+  GeglNode *color = gegl_node_new_child (graph,
+                                         "operation", "bootchk:false-color-filter",
+                                         "squared",   TRUE,
+                                         NULL);
+  GeglNode *save  = gegl_node_new_child (graph,
+                                         "operation", "gegl:save",
+                                         "path",      path,
+                                         NULL);
+
+  gegl_node_connect (canny, pad, color, "input");
+  gegl_node_link (color, save);
+
+  return save;
+}
+
+/*
+Process node in chunks, reporting progress.
+Chunks are computed and cached by GEGL, which swaps as needed.
+*/
+static void
+process (GeglNode *node)
+{
+  GeglProcessor *processor = gegl_node_new_processor (node, NULL);
+  gdouble        progress  = 0.0;
+  gint           percent   = -1;
+
+  while (gegl_processor_work (processor, &progress))
+    if (! quiet && (gint) (progress * 100) != percent)
+      {
+        percent = (gint) (progress * 100);
+        g_printerr ("\r%3d%%  peak RSS %.0f MiB", percent, peak_rss_mib ());
+      }
+
+  if (! quiet)
+    g_printerr ("\n");
+
+  g_object_unref (processor);
+}
+
+/*
+Print the statistics hysteresis leaves in its properties.
+Hysteresis is a node inside canny, a child of the canny node.
+*/
+static void
+print_hysteresis_stats (GeglNode *canny)
+{
+  GSList *children = gegl_node_get_children (canny);
+  GSList *child;
+
+  for (child = children; child != NULL; child = child->next)
+    if (g_strcmp0 (gegl_node_get_operation (child->data), "bootchk:hysteresis") == 0)
+      {
+        gint    passes;
+        gdouble promotions, strong_count, weak_count, none_count, time_ms;
+
+        gegl_node_get (child->data,
+                       "passes",       &passes,
+                       "promotions",   &promotions,
+                       "strong-count", &strong_count,
+                       "weak-count",   &weak_count,
+                       "none-count",   &none_count,
+                       "time-ms",      &time_ms,
+                       NULL);
+
+        g_printerr ("hysteresis %d passes, %.0f promotions, "
+                    "%.0f strong %.0f weak %.0f none pixels, %.1f ms\n",
+                    passes, promotions, strong_count, weak_count, none_count, time_ms);
+      }
+
+  g_slist_free (children);
+}
+
+static gpointer
+process_thread (gpointer node)
+{
+  process (node);
+
+  return NULL;
+}
+
+/*
+Render node in a thread, and while it renders, change a parameter of canny.
+The parameter change invalidates the render in progress,
+the bootchk stages notice between strips, passes, or chunks, and give way.
+Reports the latency from the change, to the stale render stopping,
+and to the fresh render done.
+*/
+static void
+measure_latency (GeglNode *node, GeglNode *canny)
+{
+  GThread *thread = g_thread_new ("render", process_thread, node);
+  gint64   changed;
+  gint64   stale_done;
+
+  g_usleep ((gulong) latency_ms * 1000);
+
+  changed = g_get_monotonic_time ();
+  gegl_node_set (canny, "strong-threshold", strong * 0.99, NULL);
+
+  g_thread_join (thread);
+  stale_done = g_get_monotonic_time ();
+
+  process (node);
+
+  g_printerr ("after change: stale render stopped %.3f s, fresh render done %.3f s\n",
+              (stale_done - changed) / (gdouble) G_USEC_PER_SEC,
+              (g_get_monotonic_time () - changed) / (gdouble) G_USEC_PER_SEC);
+}
+
+
+/* The budget of a render of a live preview, and the changes timed, see --preview. */
+#define PREVIEW_BUDGET_MS 30.0
+#define PREVIEW_CHANGES   10
+
+static gint
+compare_doubles (gconstpointer a, gconstpointer b)
+{
+  gdouble x = *(const gdouble *) a;
+  gdouble y = *(const gdouble *) b;
+
+  return (x > y) - (x < y);
+}
+
+/*
+Render a view of canny in draft, as GIMP's live preview does while a slider is dragged:
+after each change of the strong threshold, the view alone, as GIMP asks for it.
+Report the render times against the budget.
+Then set canny as committing: quality final and the threshold as given.
+GIMP does not switch the quality itself, the filter applies as previewed:
+the commit is the caller's, as here.
+*/
+static void
+measure_preview (GeglNode            *canny,
+                 const GeglRectangle *bounds,
+                 gint                 width,
+                 gint                 height)
+{
+  GeglRectangle view = { bounds->x + (bounds->width - width) / 2,
+                         bounds->y + (bounds->height - height) / 2,
+                         width, height };
+  gdouble       times[PREVIEW_CHANGES];
+  gint          in_budget = 0;
+  guint8       *pixels;
+  gint          i;
+
+  gegl_rectangle_intersect (&view, &view, bounds);
+  pixels = g_malloc ((gsize) view.width * view.height);
+
+  gegl_node_set (canny, "quality", 1, NULL);  // BOOTCHK_CANNY_QUALITY_DRAFT
+
+  for (i = 0; i < PREVIEW_CHANGES; i++)
+    {
+      gint64 start;
+
+      gegl_node_set (canny, "strong-threshold", strong * (1.0 - 0.01 * (i + 1)), NULL);
+
+      start = g_get_monotonic_time ();
+      gegl_node_blit (canny, 1.0, &view, babl_format ("Y' u8"),
+                      pixels, GEGL_AUTO_ROWSTRIDE, GEGL_BLIT_DEFAULT);
+      times[i] = (g_get_monotonic_time () - start) / 1000.0;
+
+      if (times[i] <= PREVIEW_BUDGET_MS)
+        in_budget++;
+    }
+
+  qsort (times, PREVIEW_CHANGES, sizeof (gdouble), compare_doubles);
+
+  g_printerr ("preview %d x %d draft: median %.1f ms, worst %.1f ms, "
+              "%d of %d renders within %.0f ms\n",
+              view.width, view.height, times[PREVIEW_CHANGES / 2], times[PREVIEW_CHANGES - 1],
+              in_budget, PREVIEW_CHANGES, PREVIEW_BUDGET_MS);
+
+  g_free (pixels);
+
+  gegl_node_set (canny,
+                 "quality",          0,  // BOOTCHK_CANNY_QUALITY_FINAL
+                 "strong-threshold", strong,
+                 NULL);
+  g_printerr ("commit: final quality\n");
+}
+
+
+/*
+Canny of the input file into output, unless NULL, through the result cache.
+On a miss, runs canny, from the input already loaded to hash it, and stores the edges.
+Either way output is the edges of the cache, so a hit saves the same file as a miss.
+*/
+static gboolean
+run_cached (const gchar *input_path, const gchar *output)
+{
+  ResultCache  cache;
+  GeglBuffer  *input;
+  GeglBuffer  *edges;
+  gchar       *build_id;
+  gchar       *parameters;
+  gchar       *key;
+  gdouble      compute_ms;
+  gint64       start = g_get_monotonic_time ();
+  gdouble      lookup_ms;
+
+  if (! result_cache_open (&cache, (guint64) cache_mib * 1024 * 1024))
+    return FALSE;
+
+  input = buffer_io_load (input_path);
+  if (input == NULL)
+    {
+      g_printerr ("%s: can't load\n", input_path);
+      result_cache_close (&cache);
+      return FALSE;
+    }
+
+  // Every option that changes the edges, and the version and build, for changes of canny itself.
+  build_id   = result_cache_build_id ();
+  // Bottom up: the key hashes the pixels as stored, the same as of the image flipped.
+  parameters = g_strdup_printf ("bootchk:canny %s blur %.17g weak %.17g strong %.17g half %d draft %d "
+                                "bottom-up %d\n%s",
+                                gegl_operation_get_key ("bootchk:canny", "version"),
+                                blur_amount, weak, strong, half, draft,
+                                buffer_io_is_bottom_up (input), build_id);
+  g_free (build_id);
+  key   = result_cache_key (input, parameters);
+  edges = result_cache_lookup (&cache, key, &compute_ms);
+  lookup_ms = (g_get_monotonic_time () - start) / 1000.0;
+
+  if (edges != NULL)
+    result_cache_report (&cache, TRUE, MAX (compute_ms - lookup_ms, 0.0));
+  else
+    {
+      GeglNode   *graph  = gegl_node_new ();
+      GeglBuffer *result = NULL;
+      GeglNode   *source = buffer_io_source (graph, input);
+      GeglNode   *canny  = make_canny (graph);
+      GeglNode   *sink   = gegl_node_new_child (graph,
+                                                "operation", "gegl:buffer-sink",
+                                                "buffer",    &result,
+                                                NULL);
+      gint64      compute_start = g_get_monotonic_time ();
+
+      gegl_node_link_many (source, canny, sink, NULL);
+      process (sink);
+
+      edges = gegl_buffer_new (gegl_buffer_get_extent (result), babl_format ("Y' u8"));
+      gegl_buffer_copy (result, NULL, GEGL_ABYSS_NONE, edges, NULL);
+      compute_ms = (g_get_monotonic_time () - compute_start) / 1000.0;
+
+      result_cache_store (&cache, key, edges, compute_ms);
+      result_cache_report (&cache, FALSE, 0.0);
+
+      g_object_unref (result);
+      g_object_unref (graph);
+    }
+
+  if (output != NULL)
+    buffer_io_save (edges, output);
+
+  g_printerr ("elapsed %.2f s, peak RSS %.0f MiB\n",
+              (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC,
+              peak_rss_mib ());
+
+  g_object_unref (edges);
+  g_object_unref (input);
+  g_free (parameters);
+  g_free (key);
+  result_cache_close (&cache);
+
+  return TRUE;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  GOptionContext *context;
+  GError         *error  = NULL;
+  GeglNode       *graph;
+  GeglNode       *source;
+  GeglNode       *canny;
+  GeglNode       *sink;
+  GeglNode       *extra_sinks[2];  // of canny's extra pads
+  GeglBuffer     *mapped_input = NULL;
+  gint            n_extra_sinks = 0;
+  gint            i;
+  const gchar    *output = NULL;
+  GeglRectangle   bounds;
+  gint64          start;
+
+  context = g_option_context_new ("[INPUT] [OUTPUT] - run bootchk:canny in batch");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gegl_get_option_group ());
+
+  if (! g_option_context_parse (context, &argc, &argv, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return EXIT_FAILURE;
+    }
+
+  start = g_get_monotonic_time ();
+  gegl_init (&argc, &argv);
+  g_printerr ("gegl_init %.1f ms\n", (g_get_monotonic_time () - start) / 1000.0);
+
+  if (! gegl_has_operation ("bootchk:canny"))
+    {
+      g_printerr ("bootchk:canny is not installed where GEGL looks for plugins\n");
+      return EXIT_FAILURE;
+    }
+
+  if (! set_raw_layout ())
+    return EXIT_FAILURE;
+
+  graph = gegl_node_new ();
+
+  if (sequence)
+    {
+      SequenceOptions options = { tile_size, frame_output, quiet };
+      gboolean        ok;
+
+      if (argc < 2 || tile_size <= 0 ||
+          (frame_output != NULL && ! sequence_is_valid_pattern (frame_output)))
+        {
+          g_printerr ("A sequence needs frames, a positive tile size, "
+                      "and an output pattern of one %%d\n");
+          return EXIT_FAILURE;
+        }
+
+      canny = make_canny (graph);
+      ok    = sequence_run (graph, canny, argv + 1, argc - 1, &options);
+
+      g_printerr ("peak RSS %.0f MiB\n", peak_rss_mib ());
+
+      g_object_unref (graph);
+      g_option_context_free (context);
+      g_free (frame_output);
+      gegl_exit ();
+
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if (use_cache)
+    {
+      gboolean ok;
+
+      if (argc < 2 || synthetic != NULL || latency_ms > 0 ||
+          gradient_path != NULL || nms_path != NULL)
+        {
+          g_printerr ("The cache needs an input file, "
+                      "and is not for --synthetic, --latency, --gradient, or --nms\n");
+          return EXIT_FAILURE;
+        }
+
+      ok = run_cached (argv[1], argc > 2 ? argv[2] : NULL);
+
+      g_object_unref (graph);
+      g_option_context_free (context);
+      gegl_exit ();
+
+      return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if (synthetic != NULL)
+    {
+      gint width, height;
+
+      if (sscanf (synthetic, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+        {
+          g_printerr ("Synthetic size must be WxH, e.g. 50000x50000\n");
+          return EXIT_FAILURE;
+        }
+
+      source = make_synthetic_source (graph, width, height);
+      output = argc > 1 ? argv[1] : NULL;
+    }
+  else if (argc > 1 && buffer_io_is_mapped (argv[1]))
+    {
+      mapped_input = buffer_io_load (argv[1]);
+      if (mapped_input == NULL)
+        return EXIT_FAILURE;
+
+      source = buffer_io_source (graph, mapped_input);
+      output = argc > 2 ? argv[2] : NULL;
+    }
+  else if (argc > 1)
+    {
+      source = gegl_node_new_child (graph,
+                                    "operation", "gegl:load",
+                                    "path",      argv[1],
+                                    NULL);
+      output = argc > 2 ? argv[2] : NULL;
+    }
+  else
+    {
+      g_printerr ("%s", g_option_context_get_help (context, TRUE, NULL));
+      return EXIT_FAILURE;
+    }
+
+  canny = make_canny (graph);
+  gegl_node_link (source, canny);
+
+  // A mapped output is written after canny, from its cache, see below.
+  if (output != NULL && ! buffer_io_is_mapped (output))
+    {
+      sink = gegl_node_new_child (graph,
+                                  "operation", "gegl:save",
+                                  "path",      output,
+                                  NULL);
+      gegl_node_link (canny, sink);
+    }
+  else
+    sink = canny;
+
+  if (gradient_path != NULL)
+    extra_sinks[n_extra_sinks++] = make_false_color_sink (graph, canny, "gradient", gradient_path);
+  if (nms_path != NULL)
+    extra_sinks[n_extra_sinks++] = make_false_color_sink (graph, canny, "nms", nms_path);
+
+  bounds = gegl_node_get_bounding_box (canny);
+  g_printerr ("canny %d x %d, strip height %d\n", bounds.width, bounds.height, strip_height);
+
+  if (preview_size != NULL)
+    {
+      gint width, height;
+
+      if (sscanf (preview_size, "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0 ||
+          draft || latency_ms > 0)
+        {
+          g_printerr ("Preview size must be WxH, e.g. 1280x720, "
+                      "and a preview commits in final, not with --draft or --latency\n");
+          return EXIT_FAILURE;
+        }
+
+      measure_preview (canny, &bounds, width, height);
+    }
+
+  start = g_get_monotonic_time ();
+
+  if (latency_ms > 0)
+    measure_latency (sink, canny);
+  else
+    process (sink);
+
+  // After the edges, the gradient and NMS are in the caches of canny's nodes.
+  for (i = 0; i < n_extra_sinks; i++)
+    process (extra_sinks[i]);
+
+  if (output != NULL && buffer_io_is_mapped (output))
+    {
+      gint64 save_start = g_get_monotonic_time ();
+
+      if (! buffer_io_save_node (canny, output))
+        return EXIT_FAILURE;
+
+      g_printerr ("mapped save %.1f ms\n", (g_get_monotonic_time () - save_start) / 1000.0);
+    }
+
+  g_printerr ("elapsed %.2f s, peak RSS %.0f MiB\n",
+              (g_get_monotonic_time () - start) / (gdouble) G_USEC_PER_SEC,
+              peak_rss_mib ());
+
+  print_hysteresis_stats (canny);
+
+  g_object_unref (graph);
+  g_clear_object (&mapped_input);
+  g_option_context_free (context);
+  g_free (synthetic);
+  g_free (raw_size);
+  g_free (raw_format);
+  g_free (preview_size);
+  g_free (gradient_path);
+  g_free (nms_path);
+
+  gegl_exit ();
+
+  return EXIT_SUCCESS;
+}
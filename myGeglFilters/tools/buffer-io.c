@@ -0,0 +1,518 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <gegl.h>
+
+#include "buffer-io.h"
+
+
+
+
+/* Rows per blit when saving to a mapped file. */
+#define STRIP_ROWS 256
+
+/* Object data of a buffer mapped rows bottom to top, see buffer_io_flip_node. */
+#define BOTTOM_UP_KEY "buffer-io-bottom-up"
+
+typedef enum
+{
+  MAPPED_NONE = 0,
+  MAPPED_PFM,
+  MAPPED_PGM,
+  MAPPED_RAW
+} MappedFormat;
+
+static gint        raw_width  = 0;
+static gint        raw_height = 0;
+static const Babl *raw_format = NULL;
+
+
+static MappedFormat
+mapped_format_of_path (const gchar *path)
+{
+  gchar        *lower  = g_ascii_strdown (path, -1);
+  MappedFormat  format = MAPPED_NONE;
+
+  if (g_str_has_suffix (lower, ".pfm"))
+    format = MAPPED_PFM;
+  else if (g_str_has_suffix (lower, ".pgm"))
+    format = MAPPED_PGM;
+  else if (g_str_has_suffix (lower, ".raw"))
+    format = MAPPED_RAW;
+
+  g_free (lower);
+
+  return format;
+}
+
+gboolean
+buffer_io_is_mapped (const gchar *path)
+{
+  return mapped_format_of_path (path) != MAPPED_NONE;
+}
+
+void
+buffer_io_set_raw (gint        width,
+                   gint        height,
+                   const Babl *format)
+{
+  raw_width  = width;
+  raw_height = height;
+  raw_format = format;
+}
+
+static const Babl *
+get_raw_format (void)
+{
+  return raw_format != NULL ? raw_format : babl_format ("Y float");
+}
+
+
+/*
+Read n_tokens whitespace separated tokens of a PNM header at data, skipping # comments.
+The data follows a single whitespace after the last token, at *offset.
+FALSE when the header is truncated, or a token is longer than 31.
+*/
+static gboolean
+parse_header (const gchar *data,
+              gsize        length,
+              gint         n_tokens,
+              gchar        tokens[][32],
+              gsize       *offset)
+{
+  gsize i = 0;
+  gint  t;
+
+  for (t = 0; t < n_tokens; t++)
+    {
+      gsize start;
+
+      for (;;)
+        {
+          while (i < length && g_ascii_isspace (data[i]))
+            i++;
+          if (i < length && data[i] == '#')
+            while (i < length && data[i] != '\n')
+              i++;
+          else
+            break;
+        }
+
+      start = i;
+      while (i < length && ! g_ascii_isspace (data[i]))
+        i++;
+
+      if (i == start || i - start > 31 || i == length)
+        return FALSE;
+
+      memcpy (tokens[t], data + start, i - start);
+      tokens[t][i - start] = '\0';
+    }
+
+  *offset = i + 1;  // The single whitespace after the last token.
+
+  return TRUE;
+}
+
+typedef enum
+{
+  LAYOUT_MAPPED,  // the pixels are in the file as is, to map
+  LAYOUT_SWAP,    // big endian floats, copied and swapped
+  LAYOUT_LOAD,    // not a layout mapped, by gegl:load instead
+  LAYOUT_ERROR
+} Layout;
+
+/*
+The layout of a mapped file: the format of its pixels, the extent,
+and the offset of the pixels after the header.
+LAYOUT_ERROR, after a message, when the file is not of its format, or truncated.
+*/
+static Layout
+parse_layout (const gchar   *path,
+              MappedFormat   mapped,
+              const gchar   *data,
+              gsize          length,
+              const Babl   **format,
+              GeglRectangle *extent,
+              gsize         *offset)
+{
+  Layout layout = LAYOUT_MAPPED;
+  gchar  tokens[4][32];
+  gint   width  = raw_width;
+  gint   height = raw_height;
+
+  switch (mapped)
+    {
+    case MAPPED_PFM:
+      if (! parse_header (data, length, 4, tokens, offset) ||
+          (strcmp (tokens[0], "Pf") != 0 && strcmp (tokens[0], "PF") != 0))
+        {
+          g_printerr ("%s: not a PFM\n", path);
+          return LAYOUT_ERROR;
+        }
+      // A negative scale is little endian.
+      if ((g_ascii_strtod (tokens[3], NULL) < 0.0) != (G_BYTE_ORDER == G_LITTLE_ENDIAN))
+        layout = LAYOUT_SWAP;
+      *format = babl_format (tokens[0][1] == 'f' ? "Y float" : "RGB float");
+      width   = atoi (tokens[1]);
+      height  = atoi (tokens[2]);
+      break;
+
+    case MAPPED_PGM:
+      if (! parse_header (data, length, 4, tokens, offset) || strcmp (tokens[0], "P5") != 0)
+        {
+          g_printerr ("%s: not a binary PGM\n", path);
+          return LAYOUT_ERROR;
+        }
+      // 16 bits are big endian, and other maxvals scale: gegl:load reads those.
+      if (atoi (tokens[3]) != 255)
+        return LAYOUT_LOAD;
+      *format = babl_format ("Y' u8");
+      width   = atoi (tokens[1]);
+      height  = atoi (tokens[2]);
+      break;
+
+    case MAPPED_RAW:
+      *format = get_raw_format ();
+      *offset = 0;
+      break;
+
+    default:
+      g_return_val_if_reached (LAYOUT_ERROR);
+    }
+
+  if (width <= 0 || height <= 0 ||
+      *offset + (gsize) width * height * babl_format_get_bytes_per_pixel (*format) > length)
+    {
+      g_printerr ("%s: %d x %d of %s is larger than the file, or empty\n",
+                  path, width, height, babl_get_name (*format));
+      return LAYOUT_ERROR;
+    }
+
+  gegl_rectangle_set (extent, 0, 0, width, height);
+
+  return layout;
+}
+
+/*
+Map path, and wrap its pixels in a linear buffer. The buffer holds the mapping.
+Copy on write, private: a write through the buffer changes the pages in memory, not the file.
+The pixels are copied instead when not aligned for their type, after a header
+of a length not a multiple of it, or of another byte order.
+A PFM mapped is left bottom up, marked for buffer_io_flip_node,
+a PFM copied is flipped upright by the copy, row by row.
+*fallback when the file is of a layout not mapped, to load by gegl:load.
+*/
+static GeglBuffer *
+load_mapped (const gchar  *path,
+             MappedFormat  mapped,
+             gboolean     *fallback)
+{
+  GError        *error = NULL;
+  GMappedFile   *file  = g_mapped_file_new (path, TRUE, &error);
+  gchar         *data;
+  const Babl    *format;
+  GeglRectangle  extent;
+  Layout         layout;
+  gsize          offset;
+  gsize          component_bytes;
+  gsize          rowstride;
+  gboolean       bottom_up;
+  gchar         *copy;
+  gint           row;
+
+  *fallback = FALSE;
+
+  if (file == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_error_free (error);
+      return NULL;
+    }
+
+  data   = g_mapped_file_get_contents (file);
+  layout = data == NULL ? LAYOUT_ERROR
+                        : parse_layout (path, mapped, data, g_mapped_file_get_length (file),
+                                        &format, &extent, &offset);
+
+  if (layout == LAYOUT_ERROR || layout == LAYOUT_LOAD)
+    {
+      *fallback = layout == LAYOUT_LOAD;
+      g_mapped_file_unref (file);
+      return NULL;
+    }
+
+  component_bytes = babl_format_get_bytes_per_pixel (format) / babl_format_get_n_components (format);
+  rowstride       = extent.width * babl_format_get_bytes_per_pixel (format);
+  bottom_up       = mapped == MAPPED_PFM;
+
+  if (layout == LAYOUT_MAPPED && (guintptr) (data + offset) % component_bytes == 0)
+    {
+      GeglBuffer *buffer = gegl_buffer_linear_new_from_data (data + offset, format, &extent,
+                                                             rowstride,
+                                                             (GDestroyNotify) g_mapped_file_unref,
+                                                             file);
+
+      if (bottom_up)
+        g_object_set_data (G_OBJECT (buffer), BOTTOM_UP_KEY, GINT_TO_POINTER (TRUE));
+
+      return buffer;
+    }
+
+  copy = g_malloc (rowstride * extent.height);
+  for (row = 0; row < extent.height; row++)
+    memcpy (copy + (gsize) row * rowstride,
+            data + offset + (gsize) (bottom_up ? extent.height - 1 - row : row) * rowstride,
+            rowstride);
+  g_mapped_file_unref (file);
+
+  if (layout == LAYOUT_SWAP)
+    {
+      guint32 *words = (guint32 *) copy;
+      gsize    i;
+
+      for (i = 0; i < rowstride * extent.height / sizeof (guint32); i++)
+        words[i] = GUINT32_SWAP_LE_BE (words[i]);
+    }
+
+  return gegl_buffer_linear_new_from_data (copy, format, &extent, rowstride,
+                                           g_free, copy);
+}
+
+GeglBuffer *
+buffer_io_load (const gchar *path)
+{
+  MappedFormat  mapped = mapped_format_of_path (path);
+  GeglNode     *graph;
+  GeglBuffer   *buffer = NULL;
+  GeglNode     *load;
+  GeglNode     *sink;
+
+  if (mapped != MAPPED_NONE)
+    {
+      gboolean fallback;
+
+      buffer = load_mapped (path, mapped, &fallback);
+      if (! fallback)
+        return buffer;
+    }
+
+  graph = gegl_node_new ();
+  load  = gegl_node_new_child (graph,
+                               "operation", "gegl:load",
+                               "path",      path,
+                               NULL);
+  sink  = gegl_node_new_child (graph,
+                               "operation", "gegl:buffer-sink",
+                               "buffer",    &buffer,
+                               NULL);
+
+  gegl_node_link (load, sink);
+  gegl_node_process (sink);
+  g_object_unref (graph);
+
+  // gegl:load of a missing or unreadable file is an empty image, not an error.
+  if (buffer != NULL && gegl_rectangle_is_empty (gegl_buffer_get_extent (buffer)))
+    g_clear_object (&buffer);
+
+  return buffer;
+}
+
+gboolean
+buffer_io_is_bottom_up (GeglBuffer *buffer)
+{
+  return g_object_get_data (G_OBJECT (buffer), BOTTOM_UP_KEY) != NULL;
+}
+
+GeglNode *
+buffer_io_flip_node (GeglNode   *graph,
+                     GeglBuffer *buffer)
+{
+  const GeglRectangle *extent = gegl_buffer_get_extent (buffer);
+
+  if (! buffer_io_is_bottom_up (buffer))
+    return NULL;
+
+  // Across the middle row: each pixel lands on a pixel, so nearest copies it exactly.
+  return gegl_node_new_child (graph,
+                              "operation", "gegl:reflect",
+                              "origin-y",  extent->y + extent->height / 2.0,
+                              "x",         1.0,
+                              "y",         0.0,
+                              "sampler",   GEGL_SAMPLER_NEAREST,
+                              NULL);
+}
+
+GeglNode *
+buffer_io_source (GeglNode   *graph,
+                  GeglBuffer *buffer)
+{
+  GeglNode *source = gegl_node_new_child (graph,
+                                          "operation", "gegl:buffer-source",
+                                          "buffer",    buffer,
+                                          NULL);
+  GeglNode *flip   = buffer_io_flip_node (graph, buffer);
+
+  if (flip == NULL)
+    return source;
+
+  gegl_node_link (source, flip);
+
+  return flip;
+}
+
+
+/*
+Render node over extent into path, mapped, after its header, in format.
+The file is sized first, then each strip of rows blitted into its pages.
+When bottom_up, as PFM, each strip goes to its rows counted from the end of the file,
+and its rows are reversed in place, while the strip is in cache.
+*/
+static gboolean
+save_mapped (GeglNode            *node,
+             const GeglRectangle *extent,
+             const gchar         *path,
+             const gchar         *header,
+             const Babl          *format,
+             gboolean             bottom_up)
+{
+  gsize   header_length = strlen (header);
+  gsize   rowstride     = (gsize) extent->width * babl_format_get_bytes_per_pixel (format);
+  gsize   length        = header_length + rowstride * extent->height;
+  guint8 *map;
+  guint8 *swap_row;
+  gint    fd;
+  gint    y;
+
+  fd = open (path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || ftruncate (fd, length) != 0)
+    {
+      g_printerr ("%s: %s\n", path, g_strerror (errno));
+      if (fd >= 0)
+        close (fd);
+      return FALSE;
+    }
+
+  map = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close (fd);  // The mapping holds the file.
+
+  if (map == MAP_FAILED)
+    {
+      g_printerr ("%s: %s\n", path, g_strerror (errno));
+      return FALSE;
+    }
+
+  memcpy (map, header, header_length);
+  swap_row = bottom_up ? g_malloc (rowstride) : NULL;
+
+  for (y = 0; y < extent->height; y += STRIP_ROWS)
+    {
+      GeglRectangle strip = { extent->x, extent->y + y, extent->width,
+                              MIN (STRIP_ROWS, extent->height - y) };
+      guint8       *rows  = map + header_length
+                            + (gsize) (bottom_up ? extent->height - y - strip.height : y) * rowstride;
+      gint          row;
+
+      gegl_node_blit (node, 1.0, &strip, format, rows, rowstride, GEGL_BLIT_DEFAULT);
+
+      if (bottom_up)
+        for (row = 0; row < strip.height / 2; row++)
+          {
+            guint8 *top    = rows + (gsize) row * rowstride;
+            guint8 *bottom = rows + (gsize) (strip.height - 1 - row) * rowstride;
+
+            memcpy (swap_row, top, rowstride);
+            memcpy (top, bottom, rowstride);
+            memcpy (bottom, swap_row, rowstride);
+          }
+    }
+
+  g_free (swap_row);
+
+  // Written back by the kernel, but its errors, e.g. a full disk, only show here.
+  if (msync (map, length, MS_SYNC) != 0)
+    {
+      g_printerr ("%s: %s\n", path, g_strerror (errno));
+      munmap (map, length);
+      return FALSE;
+    }
+
+  if (munmap (map, length) != 0)
+    {
+      g_printerr ("%s: %s\n", path, g_strerror (errno));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+gboolean
+buffer_io_save_node (GeglNode    *node,
+                     const gchar *path)
+{
+  MappedFormat  mapped = mapped_format_of_path (path);
+  GeglRectangle extent = gegl_node_get_bounding_box (node);
+  const Babl   *format;
+  gchar        *header;
+  gint          padding;
+  gboolean      ok;
+
+  if (mapped == MAPPED_NONE)
+    {
+      GeglNode *graph = gegl_node_new ();
+      GeglNode *save  = gegl_node_new_child (graph,
+                                             "operation", "gegl:save",
+                                             "path",      path,
+                                             NULL);
+
+      gegl_node_connect (node, "output", save, "input");
+      gegl_node_process (save);
+      g_object_unref (graph);
+
+      return TRUE;
+    }
+
+  switch (mapped)
+    {
+    case MAPPED_PFM:
+      // Canny's output is gray: its alpha, the direction, is not an image.
+      format = babl_format ("Y float");
+      // Zeros pad the scale, so the floats after the header are aligned when mapped.
+      padding = g_snprintf (NULL, 0, "Pf\n%d %d\n-1.0\n", extent.width, extent.height);
+      padding = (sizeof (gfloat) - padding % sizeof (gfloat)) % sizeof (gfloat);
+      header  = g_strdup_printf ("Pf\n%d %d\n-1.0%.*s\n", extent.width, extent.height,
+                                 padding, "000");
+      break;
+
+    case MAPPED_PGM:
+      format = babl_format ("Y' u8");
+      header = g_strdup_printf ("P5\n%d %d\n255\n", extent.width, extent.height);
+      break;
+
+    default:
+      format = get_raw_format ();
+      header = g_strdup ("");
+      break;
+    }
+
+  ok = save_mapped (node, &extent, path, header, format, mapped == MAPPED_PFM);
+
+  g_free (header);
+
+  return ok;
+}
+
+void
+buffer_io_save (GeglBuffer  *buffer,
+                const gchar *path)
+{
+  GeglNode *graph  = gegl_node_new ();
+  GeglNode *source = buffer_io_source (graph, buffer);
+
+  buffer_io_save_node (source, path);
+  g_object_unref (graph);
+}
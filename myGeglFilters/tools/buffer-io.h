@@ -0,0 +1,66 @@
+/*
+Whole images as buffers, by gegl:load and gegl:save, for the tools
+that handle pixels themselves, not only through canny's graph.
+
+Files of uncompressed formats are memory mapped instead,
+so a benchmark times canny, not a codec (zlib for PNG):
+
+  .pfm  portable float map, gray (Pf) or RGB (PF)
+  .pgm  portable gray map, 8 bits (P5, maxval 255)
+  .raw  no header: the width, height, and format of buffer_io_set_raw
+
+Loading wraps the mapping in a linear buffer, without copying:
+pages are read from disk as canny first reads them.
+The mapping is private, copy on write, so a write to the buffer never reaches the file.
+The pixels are copied instead when they are not aligned for their type,
+after a header of odd length, and a big endian PFM is copied and swapped.
+A PGM of another maxval, 16 bits or scaled, is loaded by gegl:load.
+Saving maps the output file and renders into it in strips of rows,
+one conversion from canny's format, written back by the kernel.
+A PFM saved has its header padded, so it maps aligned when loaded.
+
+PFM stores rows bottom to top, and in GEGL the image is upright, as from any reader.
+Loading keeps the mapping bottom up, without a copy, and marks the buffer:
+take it through buffer_io_source, or buffer_io_flip_node, which flip it in the graph.
+Saving writes each strip to its rows from the end of the file, reversed, in the same pass.
+*/
+
+/* Is path of a format that is memory mapped, by its extension. */
+gboolean    buffer_io_is_mapped (const gchar *path);
+
+/* The layout of .raw files, without a header. Until set, "Y float" of no size. */
+void        buffer_io_set_raw   (gint         width,
+                                 gint         height,
+                                 const Babl  *format);
+
+/*
+Load path into a new buffer. NULL, after a message when mapped, when it can't be loaded.
+Of a mapped PFM, the rows are bottom up: use the buffer through buffer_io_source.
+*/
+GeglBuffer *buffer_io_load      (const gchar *path);
+
+/* Are the rows of buffer bottom up, as buffer_io_load mapped them from a PFM. */
+gboolean    buffer_io_is_bottom_up (GeglBuffer *buffer);
+
+/*
+A gegl:reflect in graph flipping buffer upright, to link after its gegl:buffer-source,
+when buffer_io_load mapped its rows bottom up. NULL when the buffer is upright.
+*/
+GeglNode   *buffer_io_flip_node (GeglNode    *graph,
+                                 GeglBuffer  *buffer);
+
+/* A gegl:buffer-source of buffer in graph, and its flip node if any: the node to link from. */
+GeglNode   *buffer_io_source    (GeglNode    *graph,
+                                 GeglBuffer  *buffer);
+
+/* Save buffer to path, the file format by the extension. */
+void        buffer_io_save      (GeglBuffer  *buffer,
+                                 const gchar *path);
+
+/*
+Save the output of node, over its bounding box, to path.
+Rendered strip by strip into the mapped file, or through gegl:save.
+FALSE, after a message, when the file can't be written.
+*/
+gboolean    buffer_io_save_node (GeglNode    *node,
+                                 const gchar *path);
@@ -0,0 +1,450 @@
+#define _GNU_SOURCE  // dladdr
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <gegl.h>
+#include <gegl-plugin.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#include "result-cache.h"
+
+
+
+
+#define ENTRY_SUFFIX ".pbm.gz"
+#define STATS_FILE   "stats.ini"
+#define STATS_GROUP  "cache"
+
+/* Rows per get or set of a buffer, in strips, not the whole image in memory. */
+#define STRIP_ROWS 256
+
+/* Evicting goes below the cap by this fraction, so not every store evicts. */
+#define EVICT_TO 0.9
+
+
+static gchar *
+entry_path (ResultCache *cache, const gchar *key)
+{
+  gchar *name = g_strconcat (key, ENTRY_SUFFIX, NULL);
+  gchar *path = g_build_filename (cache->dir, name, NULL);
+
+  g_free (name);
+
+  return path;
+}
+
+
+gboolean
+result_cache_open (ResultCache *cache,
+                   guint64      max_bytes)
+{
+  cache->dir       = g_build_filename (g_get_user_cache_dir (), "bootchk-canny", NULL);
+  cache->max_bytes = max_bytes;
+
+  if (g_mkdir_with_parents (cache->dir, 0755) != 0)
+    {
+      g_printerr ("can't create the cache %s\n", cache->dir);
+      g_clear_pointer (&cache->dir, g_free);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+void
+result_cache_close (ResultCache *cache)
+{
+  g_clear_pointer (&cache->dir, g_free);
+}
+
+
+/*
+The modules of the bootchk: ops, each by path, size, and modification time.
+A module is found by dladdr of its op's set_property, which gegl-op.h defines in it.
+*/
+gchar *
+result_cache_build_id (void)
+{
+  GPtrArray *paths = g_ptr_array_new ();
+  GString   *id    = g_string_new (NULL);
+  gchar    **operations;
+  guint      n_operations;
+  guint      i;
+
+  operations = gegl_list_operations (&n_operations);
+
+  for (i = 0; i < n_operations; i++)
+    {
+      GObjectClass *klass;
+      Dl_info       info;
+
+      if (! g_str_has_prefix (operations[i], "bootchk:"))
+        continue;
+
+      klass = g_type_class_ref (gegl_operation_gtype_from_name (operations[i]));
+
+      if (dladdr ((gpointer) klass->set_property, &info) != 0 && info.dli_fname != NULL &&
+          ! g_ptr_array_find_with_equal_func (paths, info.dli_fname, g_str_equal, NULL))
+        g_ptr_array_add (paths, (gpointer) info.dli_fname);
+
+      g_type_class_unref (klass);
+    }
+
+  // In the order of the ops' names, sorted, so the same modules give the same id.
+  for (i = 0; i < paths->len; i++)
+    {
+      const gchar *path = g_ptr_array_index (paths, i);
+      struct stat  status;
+
+      if (stat (path, &status) == 0)
+        g_string_append_printf (id, "%s %" G_GINT64_FORMAT " %" G_GINT64_FORMAT "\n", path,
+                                (gint64) status.st_size, (gint64) status.st_mtime);
+      else
+        g_string_append_printf (id, "%s\n", path);
+    }
+
+  g_ptr_array_free (paths, TRUE);
+  g_free (operations);
+
+  return g_string_free (id, FALSE);
+}
+
+gchar *
+result_cache_key (GeglBuffer  *input,
+                  const gchar *parameters)
+{
+  const GeglRectangle *extent   = gegl_buffer_get_extent (input);
+  const Babl          *format   = gegl_buffer_get_format (input);
+  gint                 bpp      = babl_format_get_bytes_per_pixel (format);
+  GChecksum           *checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  guint8              *pixels   = g_malloc ((gsize) extent->width * STRIP_ROWS * bpp);
+  gchar               *header;
+  gchar               *key;
+  gint                 y;
+
+  // The size and format too: the same bytes are another image in another shape.
+  header = g_strdup_printf ("%s\n%s\n%d %d\n",
+                            parameters, babl_get_name (format), extent->width, extent->height);
+  g_checksum_update (checksum, (const guchar *) header, -1);
+  g_free (header);
+
+  for (y = extent->y; y < extent->y + extent->height; y += STRIP_ROWS)
+    {
+      GeglRectangle strip = { extent->x, y, extent->width,
+                              MIN (STRIP_ROWS, extent->y + extent->height - y) };
+
+      gegl_buffer_get (input, &strip, 1.0, format, pixels,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+      g_checksum_update (checksum, pixels, (gssize) strip.width * strip.height * bpp);
+    }
+
+  key = g_strdup (g_checksum_get_string (checksum));
+
+  g_checksum_free (checksum);
+  g_free (pixels);
+
+  return key;
+}
+
+
+/*
+Read the PBM of an entry from stream into a new buffer, and the compute time from its comment.
+PBM bits are 1 for black: set where there is no edge, so the file views as the edges.
+*/
+static GeglBuffer *
+read_entry (GInputStream *stream,
+            gdouble      *compute_ms)
+{
+  GDataInputStream *data   = g_data_input_stream_new (stream);
+  GeglBuffer       *edges  = NULL;
+  gchar            *lines[3] = { NULL, NULL, NULL };
+  gint              width, height;
+  gsize             row_bytes;
+  guint8           *packed = NULL;
+  guint8           *rows   = NULL;
+  gint              i, y;
+
+  for (i = 0; i < 3; i++)
+    lines[i] = g_data_input_stream_read_line (data, NULL, NULL, NULL);
+
+  if (lines[2] == NULL ||
+      strcmp (lines[0], "P4") != 0 ||
+      sscanf (lines[1], "# bootchk-canny compute-ms %lf", compute_ms) != 1 ||
+      sscanf (lines[2], "%d %d", &width, &height) != 2 ||
+      width <= 0 || height <= 0)
+    goto done;
+
+  row_bytes = (width + 7) / 8;
+  packed    = g_malloc (row_bytes * STRIP_ROWS);
+  rows      = g_malloc ((gsize) width * STRIP_ROWS);
+  edges     = gegl_buffer_new (GEGL_RECTANGLE (0, 0, width, height), babl_format ("Y' u8"));
+
+  for (y = 0; y < height; y += STRIP_ROWS)
+    {
+      GeglRectangle strip = { 0, y, width, MIN (STRIP_ROWS, height - y) };
+      gsize         read  = 0;
+      gint          row, x;
+
+      if (! g_input_stream_read_all (G_INPUT_STREAM (data), packed, row_bytes * strip.height,
+                                     &read, NULL, NULL) ||
+          read != row_bytes * strip.height)
+        {
+          g_clear_object (&edges);
+          goto done;
+        }
+
+      for (row = 0; row < strip.height; row++)
+        for (x = 0; x < width; x++)
+          rows[(gsize) row * width + x] =
+            (packed[row * row_bytes + x / 8] & (0x80 >> (x % 8))) ? 0 : 255;
+
+      gegl_buffer_set (edges, &strip, 0, babl_format ("Y' u8"), rows, GEGL_AUTO_ROWSTRIDE);
+    }
+
+done:
+  for (i = 0; i < 3; i++)
+    g_free (lines[i]);
+  g_free (packed);
+  g_free (rows);
+  g_object_unref (data);
+
+  return edges;
+}
+
+GeglBuffer *
+result_cache_lookup (ResultCache *cache,
+                     const gchar *key,
+                     gdouble     *compute_ms)
+{
+  gchar            *path = entry_path (cache, key);
+  GFile            *file = g_file_new_for_path (path);
+  GFileInputStream *in   = g_file_read (file, NULL, NULL);
+  GeglBuffer       *edges = NULL;
+
+  if (in != NULL)
+    {
+      GConverter   *decompressor = G_CONVERTER (g_zlib_decompressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+      GInputStream *stream       = g_converter_input_stream_new (G_INPUT_STREAM (in), decompressor);
+
+      edges = read_entry (stream, compute_ms);
+
+      if (edges != NULL)
+        g_utime (path, NULL);  // Recently used, last to be evicted.
+      else
+        {
+          g_printerr ("cache entry %s is unreadable, removed\n", path);
+          g_unlink (path);
+        }
+
+      g_object_unref (stream);
+      g_object_unref (decompressor);
+      g_object_unref (in);
+    }
+
+  g_object_unref (file);
+  g_free (path);
+
+  return edges;
+}
+
+
+/* Write edges to stream as a PBM, see read_entry. */
+static gboolean
+write_entry (GOutputStream *stream,
+             GeglBuffer    *edges,
+             gdouble        compute_ms,
+             GError       **error)
+{
+  const GeglRectangle *extent    = gegl_buffer_get_extent (edges);
+  gsize                row_bytes = (extent->width + 7) / 8;
+  guint8              *rows      = g_malloc ((gsize) extent->width * STRIP_ROWS);
+  guint8              *packed    = g_malloc (row_bytes * STRIP_ROWS);
+  gchar               *header;
+  gboolean             ok;
+  gint                 y;
+
+  header = g_strdup_printf ("P4\n# bootchk-canny compute-ms %.1f\n%d %d\n",
+                            compute_ms, extent->width, extent->height);
+  ok = g_output_stream_write_all (stream, header, strlen (header), NULL, NULL, error);
+  g_free (header);
+
+  for (y = 0; ok && y < extent->height; y += STRIP_ROWS)
+    {
+      GeglRectangle strip = { extent->x, extent->y + y, extent->width,
+                              MIN (STRIP_ROWS, extent->height - y) };
+      gint          row, x;
+
+      gegl_buffer_get (edges, &strip, 1.0, babl_format ("Y' u8"), rows,
+                       GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+
+      memset (packed, 0, row_bytes * strip.height);
+      for (row = 0; row < strip.height; row++)
+        for (x = 0; x < strip.width; x++)
+          if (rows[(gsize) row * strip.width + x] < 128)
+            packed[row * row_bytes + x / 8] |= 0x80 >> (x % 8);
+
+      ok = g_output_stream_write_all (stream, packed, row_bytes * strip.height, NULL, NULL, error);
+    }
+
+  g_free (rows);
+  g_free (packed);
+
+  return ok;
+}
+
+typedef struct
+{
+  gchar  *path;
+  guint64 bytes;
+  gint64  mtime;
+} Entry;
+
+static gint
+compare_entries_by_age (gconstpointer a, gconstpointer b)
+{
+  gint64 difference = ((const Entry *) a)->mtime - ((const Entry *) b)->mtime;
+
+  return difference < 0 ? -1 : difference > 0;
+}
+
+/* When the entries exceed the cap, remove the least recently used, to below the cap. */
+static void
+evict (ResultCache *cache)
+{
+  GDir        *dir = g_dir_open (cache->dir, 0, NULL);
+  GArray      *entries;
+  const gchar *name;
+  guint64      total = 0;
+  guint        evicted = 0;
+  guint        i;
+
+  if (dir == NULL)
+    return;
+
+  entries = g_array_new (FALSE, FALSE, sizeof (Entry));
+
+  while ((name = g_dir_read_name (dir)) != NULL)
+    {
+      Entry    entry;
+      GStatBuf stat;
+
+      if (! g_str_has_suffix (name, ENTRY_SUFFIX))
+        continue;
+
+      entry.path = g_build_filename (cache->dir, name, NULL);
+      if (g_stat (entry.path, &stat) != 0)
+        {
+          g_free (entry.path);
+          continue;  // Evicted by another job.
+        }
+
+      entry.bytes = stat.st_size;
+      entry.mtime = stat.st_mtime;
+      total += entry.bytes;
+      g_array_append_val (entries, entry);
+    }
+  g_dir_close (dir);
+
+  if (total > cache->max_bytes)
+    {
+      g_array_sort (entries, compare_entries_by_age);
+
+      for (i = 0; i < entries->len && total > cache->max_bytes * EVICT_TO; i++)
+        {
+          Entry *entry = &g_array_index (entries, Entry, i);
+
+          if (g_unlink (entry->path) == 0)
+            evicted++;
+          total -= entry->bytes;
+        }
+
+      g_printerr ("cache evicted %u entries, %.1f MiB remain\n",
+                  evicted, total / (1024.0 * 1024.0));
+    }
+
+  for (i = 0; i < entries->len; i++)
+    g_free (g_array_index (entries, Entry, i).path);
+  g_array_free (entries, TRUE);
+}
+
+void
+result_cache_store (ResultCache *cache,
+                    const gchar *key,
+                    GeglBuffer  *edges,
+                    gdouble      compute_ms)
+{
+  gchar             *path = entry_path (cache, key);
+  GFile             *file = g_file_new_for_path (path);
+  GError            *error = NULL;
+  GFileOutputStream *out;
+
+  // Replacing writes a temporary file, renamed over the entry when closed.
+  out = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error);
+
+  if (out != NULL)
+    {
+      GConverter    *compressor  = G_CONVERTER (g_zlib_compressor_new (G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1));
+      GOutputStream *stream      = g_converter_output_stream_new (G_OUTPUT_STREAM (out), compressor);
+      GCancellable  *cancellable = g_cancellable_new ();
+
+      if (! write_entry (stream, edges, compute_ms, &error))
+        g_cancellable_cancel (cancellable);  // Closing cancelled leaves no partial entry.
+
+      g_output_stream_close (stream, cancellable, error == NULL ? &error : NULL);
+
+      g_object_unref (cancellable);
+      g_object_unref (stream);
+      g_object_unref (compressor);
+      g_object_unref (out);
+    }
+
+  if (error != NULL)
+    {
+      g_printerr ("can't store the cache entry %s: %s\n", path, error->message);
+      g_error_free (error);
+    }
+  else
+    evict (cache);
+
+  g_object_unref (file);
+  g_free (path);
+}
+
+
+void
+result_cache_report (ResultCache *cache,
+                     gboolean     hit,
+                     gdouble      saved_ms)
+{
+  gchar    *path  = g_build_filename (cache->dir, STATS_FILE, NULL);
+  GKeyFile *stats = g_key_file_new ();
+  gint      hits, misses;
+  gdouble   total_saved_ms;
+
+  // Missing or not yet written: counts from zero. Concurrent jobs can lose a count.
+  g_key_file_load_from_file (stats, path, G_KEY_FILE_NONE, NULL);
+
+  hits           = g_key_file_get_integer (stats, STATS_GROUP, "hits", NULL) + (hit ? 1 : 0);
+  misses         = g_key_file_get_integer (stats, STATS_GROUP, "misses", NULL) + (hit ? 0 : 1);
+  total_saved_ms = g_key_file_get_double (stats, STATS_GROUP, "saved-ms", NULL) + saved_ms;
+
+  g_key_file_set_integer (stats, STATS_GROUP, "hits", hits);
+  g_key_file_set_integer (stats, STATS_GROUP, "misses", misses);
+  g_key_file_set_double  (stats, STATS_GROUP, "saved-ms", total_saved_ms);
+  g_key_file_save_to_file (stats, path, NULL);
+
+  if (hit)
+    g_printerr ("cache hit, saved %.2f s\n", saved_ms / 1000.0);
+  else
+    g_printerr ("cache miss, stored\n");
+
+  g_printerr ("cache %d hits of %d lookups (%.0f%%), %.1f s saved in all\n",
+              hits, hits + misses, 100.0 * hits / (hits + misses), total_saved_ms / 1000.0);
+
+  g_key_file_free (stats);
+  g_free (path);
+}
@@ -0,0 +1,60 @@
+/*
+A persistent cache of canny's results, on disk, addressed by content.
+
+For batch jobs that run canny again over the same images with the same parameters:
+a hit skips the pipeline, only the input is loaded and hashed.
+
+The key is a SHA-256 of the input's pixels, size, and format,
+and of a string of the parameters, which includes the version of canny,
+and the build of the ops, result_cache_build_id: canny's version key is not bumped
+by every change of its output, but a rebuilt module is another build, its entries misses.
+An entry is the binary edge map, one bit per pixel, as a PBM, compressed by gzip:
+a 12 megapixel map is about 1.5 MB before compression, and edges compress well.
+The entry also records how long canny took, to report the time a hit saves.
+
+Entries are files in $XDG_CACHE_HOME/bootchk-canny.
+Stored atomically, by rename, so concurrent jobs can share the cache.
+Evicted least recently used first, by modification time, which a hit touches,
+when the files exceed the size cap.
+A file of statistics counts hits, misses, and the time saved, over all runs.
+*/
+typedef struct
+{
+  gchar   *dir;        // of the entries
+  guint64  max_bytes;  // size cap of the entries
+} ResultCache;
+
+/* Open the cache, creating its directory. FALSE, after a message, when it can't be. */
+gboolean    result_cache_open   (ResultCache *cache,
+                                 guint64      max_bytes);
+
+void        result_cache_close  (ResultCache *cache);
+
+/*
+The build of the ops, to key results by: the path, size, and modification time
+of each module registering a bootchk: op, as loaded by gegl_init. A string to free.
+*/
+gchar      *result_cache_build_id (void);
+
+/* The key of input and the parameters of canny, a hex string to free. */
+gchar      *result_cache_key    (GeglBuffer  *input,
+                                 const gchar *parameters);
+
+/*
+The edges of key, a new buffer of "Y' u8", white edges on black,
+and the milliseconds canny took for them. NULL when not cached, or unreadable.
+*/
+GeglBuffer *result_cache_lookup (ResultCache *cache,
+                                 const gchar *key,
+                                 gdouble     *compute_ms);
+
+/* Store the edges of key, thresholded at half gray, which took compute_ms. Then evict. */
+void        result_cache_store  (ResultCache *cache,
+                                 const gchar *key,
+                                 GeglBuffer  *edges,
+                                 gdouble      compute_ms);
+
+/* Count a hit or miss, and the milliseconds saved, and print the totals. */
+void        result_cache_report (ResultCache *cache,
+                                 gboolean     hit,
+                                 gdouble      saved_ms);
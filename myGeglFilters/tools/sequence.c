@@ -0,0 +1,235 @@
+#include <string.h>
+
+#include <gegl.h>
+
+#include "buffer-io.h"
+#include "sequence.h"
+
+
+
+
+/*
+Is pattern a printf pattern of one int, e.g. edges-%04d.png, and nothing else to format?
+Given by the user, it must not read arguments that are not there.
+*/
+gboolean
+sequence_is_valid_pattern (const gchar *pattern)
+{
+  gint conversions = 0;
+
+  for (; *pattern != '\0'; pattern++)
+    {
+      if (*pattern != '%')
+        continue;
+
+      pattern++;
+      if (*pattern == '%')
+        continue;  // A literal percent.
+
+      while (g_ascii_isdigit (*pattern))
+        pattern++;
+
+      if (*pattern != 'd')
+        return FALSE;
+
+      conversions++;
+    }
+
+  return conversions == 1;
+}
+
+/* The rect of tile index, of the grid of tile_size over extent, clipped to extent. */
+static GeglRectangle
+tile_rect (const GeglRectangle *extent, gint tile_size, gint tiles_across, gint index)
+{
+  GeglRectangle rect = { extent->x + (index % tiles_across) * tile_size,
+                         extent->y + (index / tiles_across) * tile_size,
+                         tile_size, tile_size };
+
+  gegl_rectangle_intersect (&rect, &rect, extent);
+
+  return rect;
+}
+
+/*
+Get rect of frame into pixels, upright, rows of rowstride.
+A frame mapped bottom up (a PFM, see buffer_io_load) gets the mirrored rows, reversed,
+so current is upright, and the graph needs no flip.
+*/
+static void
+get_upright (GeglBuffer          *frame,
+             const GeglRectangle *extent,
+             const GeglRectangle *rect,
+             const Babl          *format,
+             guint8              *pixels,
+             guint8              *swap_row)
+{
+  gsize         rowstride = (gsize) rect->width * babl_format_get_bytes_per_pixel (format);
+  GeglRectangle stored    = *rect;
+  gint          row;
+
+  if (! buffer_io_is_bottom_up (frame))
+    {
+      gegl_buffer_get (frame, rect, 1.0, format, pixels, rowstride, GEGL_ABYSS_NONE);
+      return;
+    }
+
+  stored.y = 2 * extent->y + extent->height - rect->y - rect->height;
+  gegl_buffer_get (frame, &stored, 1.0, format, pixels, rowstride, GEGL_ABYSS_NONE);
+
+  for (row = 0; row < rect->height / 2; row++)
+    {
+      guint8 *top    = pixels + row * rowstride;
+      guint8 *bottom = pixels + (rect->height - 1 - row) * rowstride;
+
+      memcpy (swap_row, top, rowstride);
+      memcpy (top, bottom, rowstride);
+      memcpy (bottom, swap_row, rowstride);
+    }
+}
+
+/* Render node in chunks, as the batch does, into the caches of the graph. */
+static void
+render (GeglNode *node)
+{
+  GeglProcessor *processor = gegl_node_new_processor (node, NULL);
+
+  while (gegl_processor_work (processor, NULL))
+    ;
+
+  g_object_unref (processor);
+}
+
+
+gboolean
+sequence_run (GeglNode              *graph,
+              GeglNode              *canny,
+              gchar                **frames,
+              gint                   n_frames,
+              const SequenceOptions *options)
+{
+  GeglNode     *source;
+  GeglBuffer   *current = NULL;  // the frame canny sees, updated where frames differ
+  GeglRectangle extent;
+  const Babl   *format  = NULL;
+  guint8       *pixels  = NULL;  // a tile of the frame
+  guint8       *previous = NULL;  // the same tile of current, to compare
+  guint8       *swap_row = NULL;  // a row of a tile, to flip a frame bottom up
+  gint          tiles_across = 0;
+  gint          n_tiles = 0;
+  gint64        total_us = 0;
+  guint64       total_changed = 0;
+  gboolean      ok = TRUE;
+  gint          i;
+
+  source = gegl_node_new_child (graph, "operation", "gegl:buffer-source", NULL);
+  gegl_node_link (source, canny);
+
+  for (i = 0; i < n_frames; i++)
+    {
+      GeglBuffer *frame = buffer_io_load (frames[i]);
+      gint        changed = 0;
+      gint64      start;
+      gint64      canny_us;
+      gint        t;
+
+      if (frame == NULL)
+        {
+          g_printerr ("%s: can't load\n", frames[i]);
+          ok = FALSE;
+          break;
+        }
+
+      if (current == NULL)
+        {
+          gint tiles_down;
+
+          extent       = *gegl_buffer_get_extent (frame);
+          format       = gegl_buffer_get_format (frame);
+          tiles_across = (extent.width + options->tile_size - 1) / options->tile_size;
+          tiles_down   = (extent.height + options->tile_size - 1) / options->tile_size;
+          n_tiles      = tiles_across * tiles_down;
+          pixels       = g_malloc ((gsize) options->tile_size * options->tile_size
+                                   * babl_format_get_bytes_per_pixel (format));
+          previous     = g_malloc ((gsize) options->tile_size * options->tile_size
+                                   * babl_format_get_bytes_per_pixel (format));
+          swap_row     = g_malloc ((gsize) options->tile_size
+                                   * babl_format_get_bytes_per_pixel (format));
+
+          current = gegl_buffer_new (&extent, format);
+          gegl_node_set (source, "buffer", current, NULL);
+        }
+      else if (! gegl_rectangle_equal (gegl_buffer_get_extent (frame), &extent))
+        {
+          g_printerr ("%s: size differs from the first frame\n", frames[i]);
+          g_object_unref (frame);
+          ok = FALSE;
+          break;
+        }
+
+      start = g_get_monotonic_time ();
+
+      /*
+      Copy the changed tiles only: each copy invalidates its rect downstream,
+      by the buffer's changed signal, which gegl:buffer-source forwards.
+      Changed by comparing the bytes of the tile in current, exactly:
+      a tile wrongly taken as unchanged would leave stale edges in the frame.
+      memcmp stops at the first difference, so a changed tile costs little of it.
+      */
+      for (t = 0; t < n_tiles; t++)
+        {
+          GeglRectangle rect    = tile_rect (&extent, options->tile_size, tiles_across, t);
+          gsize         n_bytes = (gsize) rect.width * rect.height
+                                  * babl_format_get_bytes_per_pixel (format);
+
+          get_upright (frame, &extent, &rect, format, pixels, swap_row);
+
+          if (i > 0)
+            {
+              gegl_buffer_get (current, &rect, 1.0, format, previous,
+                               GEGL_AUTO_ROWSTRIDE, GEGL_ABYSS_NONE);
+              if (memcmp (pixels, previous, n_bytes) == 0)
+                continue;
+            }
+
+          gegl_buffer_set (current, &rect, 0, format, pixels, GEGL_AUTO_ROWSTRIDE);
+          changed++;
+        }
+
+      g_object_unref (frame);
+
+      render (canny);
+      canny_us = g_get_monotonic_time () - start;
+
+      // From the caches of canny, memory mapped for .pfm, .pgm, or .raw.
+      if (options->output_pattern != NULL)
+        {
+          gchar *path = g_strdup_printf (options->output_pattern, i);
+
+          buffer_io_save_node (canny, path);
+          g_free (path);
+        }
+
+      total_us      += canny_us;
+      total_changed += changed;
+
+      if (! options->quiet)
+        g_printerr ("frame %d: %d of %d tiles changed, reuse %.1f%%, "
+                    "canny %.1f ms, with save %.1f ms\n",
+                    i, changed, n_tiles, 100.0 * (n_tiles - changed) / n_tiles,
+                    canny_us / 1000.0, (g_get_monotonic_time () - start) / 1000.0);
+    }
+
+  if (ok && n_frames > 1)
+    g_printerr ("%d frames, reuse %.1f%% of tiles after the first, canny %.1f ms per frame\n",
+                n_frames,
+                100.0 - 100.0 * (total_changed - n_tiles) / ((gdouble) n_tiles * (n_frames - 1)),
+                total_us / 1000.0 / n_frames);
+
+  g_clear_object (&current);
+  g_free (pixels);
+  g_free (previous);
+  g_free (swap_row);
+
+  return ok;
+}
@@ -0,0 +1,34 @@
+/*
+Canny over a sequence of frames, e.g. from a fixed camera,
+recomputing only where a frame changed from the frame before.
+
+The frames go through one graph: a buffer source, canny, and a save when output.
+Each frame is compared to the previous, tile by tile, byte for byte.
+Only the changed tiles are copied into the source buffer,
+which invalidates only those tiles, and what depends on them, in GEGL's caches:
+the blur, gradient, and NMS grow the invalidated area by their radius, no more.
+Hysteresis is not local, so it is recomputed whole, from the cached stages upstream.
+
+Reports per frame the tiles changed, the reuse ratio, and the latency,
+and a summary after the last frame.
+*/
+typedef struct
+{
+  gint         tile_size;       // pixels square, the unit of change
+  const gchar *output_pattern;  // printf pattern of the frame index, or NULL to discard
+  gboolean     quiet;
+} SequenceOptions;
+
+/* Is pattern a printf pattern of one int, the frame index, e.g. edges-%04d.png. */
+gboolean sequence_is_valid_pattern (const gchar *pattern);
+
+/*
+Run canny, not yet linked to a source, over the frames, files loaded by gegl:load.
+The frames must all have the size of the first.
+Returns FALSE, after a message, when a frame can't be loaded or has another size.
+*/
+gboolean sequence_run (GeglNode              *graph,
+                       GeglNode              *canny,
+                       gchar                **frames,
+                       gint                   n_frames,
+                       const SequenceOptions *options);
@@ -5,6 +5,10 @@ property_double (magnitude_emphasis, "Emphasis", 2.0)
     ui_range    (1, 10)
     description("Emphasize the magnitude of the gradient by this factor.")
 
+property_boolean (squared, "Squared magnitude", FALSE)
+  description ("The magnitude channel is squared, as from canny's gradient and nms pads. "
+               "Shows the magnitude, as from a gradient with the square root.")
+
 #else
 
 // Boilerplate code for a GEGL operation
@@ -18,13 +22,15 @@ property_double (magnitude_emphasis, "Emphasis", 2.0)
 // Base on the above definitions, gegl-op.h generates code for the operation
 #include "gegl-op.h"
 
-#include <math.h>
+#include "bootchk-kernels.h"
+#include "gradient-format.h"
+#include "op-trace.h"
 
 static void prepare (GeglOperation *operation)
 {
   const Babl *space = gegl_operation_get_source_space (operation, "input");
 
-   const Babl *gradient_format= babl_format_n (babl_type ("float"), 2);
+  const Babl *gradient_format = bootchk_gradient_format ();
 
   // Set the input format to a two-channel float format, which is suitable for gradients.
   gegl_operation_set_format (operation, "input",  gradient_format);
@@ -34,12 +40,6 @@ static void prepare (GeglOperation *operation)
 
 
 
-#define input_FPP  2 // Floats per pixel for the input format
-#define output_FPP 3 // Floats per pixel for the output format (HSV float has three channels)
-
-
-
-
 /*
 Convert a vector field gradient to false colors.
 
@@ -63,7 +63,12 @@ and not represent the direction at all, or as transparency.
 (Which is what gegl:image-gradient does, it shows a grayscale image i.e. Y'A)
 
 An alternative implementation might be in BABL.
-*/ 
+
+When squared, the emphasis is doubled: the root of the square is the root of the magnitude,
+so the colors are those of the magnitude, without a square root per pixel first.
+
+The loop is bootchk_false_color, in the kernels library.
+*/
 static gboolean
 process (GeglOperation       *op,
          void                *in_buf,
@@ -72,35 +77,14 @@ process (GeglOperation       *op,
          const GeglRectangle *roi,
          gint                 level)
 {
-  // Pointers used to scan buffer.
-  gfloat *in  = in_buf;
-  gfloat *out = out_buf;
-  
-  gfloat magnitude_emphasis  = GEGL_PROPERTIES (op)->magnitude_emphasis;
-
-  for (glong i=0; i<n_pixels; i++)
-    {
-      
-      float calculated_hue = (in[1] + M_PI) / (2 * M_PI);
-      float calculated_magnitude = in[0];
-
-      out[0] = calculated_hue;
-
-      // Amplify/emphasize low values of the gradient magnitude.
-      // Get the nth root of the magnitude to emphasize low values.
-      calculated_magnitude = pow(calculated_magnitude, 1.0 / magnitude_emphasis);
+  GeglProperties *o                  = GEGL_PROPERTIES (op);
+  gfloat          magnitude_emphasis = o->squared ? 2 * o->magnitude_emphasis
+                                                  : o->magnitude_emphasis;
+  OpTrace         trace;
 
-      // Magnitude of the gradient => Value and Saturation in HSV color space.
-      out[2] = calculated_magnitude;
-      out[1] = calculated_magnitude;
-
-      // Alternatively, Constant, full Saturation in HSV color space.
-      // out[1] = 1.0f; // Full saturation
-
-      // Move to the next pixel.
-      in  += input_FPP;
-      out += output_FPP;
-    }
+  op_trace_begin (&trace, op, roi);
+  bootchk_false_color (in_buf, out_buf, n_pixels, magnitude_emphasis);
+  op_trace_end (&trace);
 
   return TRUE;
 }
@@ -120,6 +104,9 @@ gegl_op_class_init (GeglOpClass *klass)
   point_filter_class->process = process;
   operation_class->prepare    = prepare;
 
+  // Select the kernels for the CPU once, at load, not in a thread of process.
+  bootchk_kernels_init ();
+
   gegl_operation_class_set_keys (operation_class,
                                  "title",       "False color a vector field",
                                  "name",        "bootchk:false-color-filter",